@@ -0,0 +1,579 @@
+/*
+* Copyright (c) 2012, Alexander I. Mykyta
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+* ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/**
+* \addtogroup MOD_FLASHFTL
+* \{
+**/
+
+/**
+* \file
+* \brief Code for \ref MOD_FLASHFTL "Flash Translation Layer"
+**/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "FlashSPAN.h"
+#include "FlashFTL.h"
+
+//==================================================================================================
+// Internal Functions
+//==================================================================================================
+///\cond INTERNAL
+
+#if FTL_RESERVE_BLOCKS < 2
+#error "FTL_RESERVE_BLOCKS must be at least 2"
+#endif
+#if FTL_GC_BACKGROUND < 2
+#error "FTL_GC_BACKGROUND must be at least 2"
+#endif
+
+#define FTL_MAGIC       0x4C54
+#define PAGE_NONE       0xFFFF
+#define BLOCK_NONE      0xFFFF
+#define SEQ_NONE        0xFFFFFFFFUL
+
+// Bytes moved per flashSPAN call when a page is relocated
+#define COPY_CHUNK      64
+
+/// \name Block States
+///\{
+#define BLK_FREE        0   // Erased. The header holds the erase count only.
+#define BLK_OPEN        1   // Receiving pages
+#define BLK_USED        2   // Full or closed by a mount
+#define BLK_DIRTY       3   // Invalid header. Needs an erase.
+///\}
+
+// Block header at the start of the header page. Fields are programmed at different times.
+typedef struct
+{
+    uint16_t magic;                     // written with eraseCount after every erase
+    uint16_t reserved;
+    uint32_t eraseCount;
+    uint32_t seq;                       // written when the block is opened
+    uint16_t sector[FTL_DATA_PAGES];    // written after the data of each page
+} ftlHeader_t;
+
+static uint16_t Map[FTL_SECTOR_COUNT];      // physical page of each sector, PAGE_NONE if unwritten
+static uint32_t EraseCount[FTL_BLOCKS];
+static uint32_t Seq[FTL_BLOCKS];            // sequence number of each used block, for mount
+static uint8_t Valid[FTL_BLOCKS];           // pages of each block that are still mapped
+static uint8_t State[FTL_BLOCKS];
+static uint16_t FreeBlocks;
+static uint16_t OpenBlock;
+static uint8_t OpenPage;                    // next data page of the open block
+static uint32_t NextSeq;
+static uint16_t Victim;                     // block being reclaimed
+static uint8_t VictimPage;                  // next page of the victim to check
+static uint16_t VictimSector[FTL_DATA_PAGES];
+static uint8_t Mounted;
+static flashFTL_stats_t Stats;
+
+//--------------------------------------------------------------------------------------------------
+static uint32_t blockAddress(uint16_t block)
+{
+    return((FTL_FIRST_BLOCK + (uint32_t)block) * FLASH_VOLUME_BLOCKSIZE);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Volume address of a physical page. Page 0 of a block is the first page after the header.
+static uint32_t pageAddress(uint16_t page)
+{
+    return(blockAddress(page / FTL_DATA_PAGES)
+           + ((uint32_t)(page % FTL_DATA_PAGES) + 1) * FTL_SECTOR_SIZE);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Erases a block and writes its header with the new erase count
+static RES_t eraseBlock(uint16_t block)
+{
+    ftlHeader_t hdr;
+    RES_t res;
+
+    res = flashSPAN_EraseBlock(FTL_FIRST_BLOCK + block);
+    if (res != RES_OK)
+    {
+        return(res);
+    }
+
+    EraseCount[block]++;
+    memset(&hdr, 0xFF, sizeof(hdr));
+    hdr.magic = FTL_MAGIC;
+    hdr.eraseCount = EraseCount[block];
+    flashSPAN_Write(blockAddress(block), (uint8_t *)&hdr, offsetof(ftlHeader_t, seq));
+
+    State[block] = BLK_FREE;
+    Valid[block] = 0;
+    FreeBlocks++;
+    Stats.erases++;
+    return(RES_OK);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Opens the free block with the lowest erase count. There must be a free block.
+static void openBlock(void)
+{
+    uint16_t b;
+    uint16_t best = BLOCK_NONE;
+    uint32_t seq;
+
+    for (b = 0; b < FTL_BLOCKS; b++)
+    {
+        if ((State[b] == BLK_FREE) && ((best == BLOCK_NONE) || (EraseCount[b] < EraseCount[best])))
+        {
+            best = b;
+        }
+    }
+
+    seq = NextSeq++;
+    flashSPAN_Write(blockAddress(best) + offsetof(ftlHeader_t, seq), (uint8_t *)&seq, sizeof(seq));
+    State[best] = BLK_OPEN;
+    Seq[best] = seq;
+    FreeBlocks--;
+    OpenBlock = best;
+    OpenPage = 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Chooses the next block to reclaim: the closed block with the fewest valid pages, or the least
+// worn closed block once it lags too far behind the most worn block.
+static uint16_t pickVictim(void)
+{
+    uint16_t b;
+    uint16_t best = BLOCK_NONE;
+    uint16_t coldest = BLOCK_NONE;
+    uint32_t maxErase = 0;
+
+    for (b = 0; b < FTL_BLOCKS; b++)
+    {
+        if (EraseCount[b] > maxErase)
+        {
+            maxErase = EraseCount[b];
+        }
+        if (State[b] != BLK_USED)
+        {
+            continue;
+        }
+        if ((coldest == BLOCK_NONE) || (EraseCount[b] < EraseCount[coldest]))
+        {
+            coldest = b;
+        }
+        if ((Valid[b] < FTL_DATA_PAGES) && ((best == BLOCK_NONE) || (Valid[b] < Valid[best])))
+        {
+            best = b;
+        }
+    }
+
+    if ((coldest != BLOCK_NONE) && ((maxErase - EraseCount[coldest]) > FTL_WEAR_DELTA))
+    {
+        return(coldest);
+    }
+    return(best);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Reopens the newest block at mount when pages after its last committed page are still blank.
+// Without it a power loss while the collector filled the last free block leaves nothing to write.
+static void resumeBlock(uint16_t block)
+{
+    uint16_t sector[FTL_DATA_PAGES];
+    uint8_t buf[COPY_CHUNK];
+    flashSPAN_iovec_t iov;
+    uint16_t offset;
+    uint8_t page;
+    uint8_t i;
+
+    flashSPAN_Read(blockAddress(block) + offsetof(ftlHeader_t, sector), (uint8_t *)sector,
+                   sizeof(sector));
+    for (page = FTL_DATA_PAGES; (page > 0) && (sector[page - 1] == 0xFFFF); page--);
+
+    // The data of a page is programmed before its sector number, so the page may not be blank
+    iov.data = buf;
+    iov.nBytes = COPY_CHUNK;
+    for (; page < FTL_DATA_PAGES; page++)
+    {
+        for (offset = 0; offset < FTL_SECTOR_SIZE; offset += COPY_CHUNK)
+        {
+            flashSPAN_ReadV(pageAddress(block * FTL_DATA_PAGES + page) + offset, &iov, 1);
+            for (i = 0; (i < COPY_CHUNK) && (buf[i] == 0xFF); i++);
+            if (i < COPY_CHUNK)
+            {
+                break;
+            }
+        }
+        if (offset >= FTL_SECTOR_SIZE)
+        {
+            State[block] = BLK_OPEN;
+            OpenBlock = block;
+            OpenPage = page;
+            return;
+        }
+    }
+}
+
+static RES_t allocPage(uint8_t gc, uint16_t *page);
+
+//--------------------------------------------------------------------------------------------------
+// Programs the sector number of a page into its block header and maps the sector to the page
+static void commitPage(uint16_t sector, uint16_t page)
+{
+    uint16_t block = page / FTL_DATA_PAGES;
+    uint16_t old = Map[sector];
+
+    flashSPAN_Write(blockAddress(block) + offsetof(ftlHeader_t, sector)
+                    + (page % FTL_DATA_PAGES) * sizeof(sector), (uint8_t *)&sector, sizeof(sector));
+    if (old != PAGE_NONE)
+    {
+        Valid[old / FTL_DATA_PAGES]--;
+    }
+    Map[sector] = page;
+    Valid[block]++;
+    Stats.pageWrites++;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Moves one valid page of the victim, or erases the victim once it has none left
+static RES_t collectStep(void)
+{
+    uint8_t buf[COPY_CHUNK];
+    flashSPAN_iovec_t iov;
+    uint16_t sector;
+    uint16_t from;
+    uint16_t to;
+    uint16_t offset;
+    RES_t res;
+
+    if (Victim == BLOCK_NONE)
+    {
+        Victim = pickVictim();
+        if (Victim == BLOCK_NONE)
+        {
+            return(RES_FULL);
+        }
+        flashSPAN_Read(blockAddress(Victim) + offsetof(ftlHeader_t, sector),
+                       (uint8_t *)VictimSector, sizeof(VictimSector));
+        VictimPage = 0;
+    }
+
+    // Skip pages that were never written or hold a stale copy
+    for (; VictimPage < FTL_DATA_PAGES; VictimPage++)
+    {
+        sector = VictimSector[VictimPage];
+        if ((sector < FTL_SECTOR_COUNT) && (Map[sector] == (Victim * FTL_DATA_PAGES + VictimPage)))
+        {
+            break;
+        }
+    }
+
+    if (VictimPage == FTL_DATA_PAGES)
+    {
+        res = eraseBlock(Victim);
+        Victim = BLOCK_NONE;
+        return(res);
+    }
+    sector = VictimSector[VictimPage];
+    from = Victim * FTL_DATA_PAGES + VictimPage;
+
+    res = allocPage(1, &to);
+    if (res != RES_OK)
+    {
+        return(res);
+    }
+
+    // flashSPAN_ReadV() does not go through the read cache, which would only fill with dead data
+    iov.data = buf;
+    iov.nBytes = COPY_CHUNK;
+    for (offset = 0; offset < FTL_SECTOR_SIZE; offset += COPY_CHUNK)
+    {
+        flashSPAN_ReadV(pageAddress(from) + offset, &iov, 1);
+        flashSPAN_Write(pageAddress(to) + offset, buf, COPY_CHUNK);
+    }
+    commitPage(sector, to);
+    Stats.relocations++;
+    VictimPage++;
+    return(RES_OK);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Finds the next free page. Writes from the application (gc = 0) keep one free block in reserve
+// for the block being reclaimed, and reclaim blocks first when that reserve is short.
+static RES_t allocPage(uint8_t gc, uint16_t *page)
+{
+    uint8_t full;
+    RES_t res;
+
+    for (;;)
+    {
+        full = (OpenBlock == BLOCK_NONE) || (OpenPage == FTL_DATA_PAGES);
+        if (!gc && ((FreeBlocks == 0) || (full && (FreeBlocks < 2))))
+        {
+            res = collectStep();
+            if (res != RES_OK)
+            {
+                return(res);
+            }
+            continue;
+        }
+        if (!full)
+        {
+            break;
+        }
+        if (OpenBlock != BLOCK_NONE)
+        {
+            State[OpenBlock] = BLK_USED;
+            OpenBlock = BLOCK_NONE;
+        }
+        if (FreeBlocks == 0)
+        {
+            return(RES_FULL);
+        }
+        openBlock();
+    }
+
+    *page = OpenBlock * FTL_DATA_PAGES + OpenPage;
+    OpenPage++;
+    return(RES_OK);
+}
+
+///\endcond
+//==================================================================================================
+// Functions
+//==================================================================================================
+
+//--------------------------------------------------------------------------------------------------
+RES_t flashFTL_Format(void)
+{
+    ftlHeader_t hdr;
+    uint16_t b;
+    RES_t res;
+
+    if ((FTL_FIRST_BLOCK + FTL_BLOCKS) > flashSPAN.BlockCount)
+    {
+        return(RES_PARAMERR);
+    }
+
+    // Carry over the erase count of blocks that were formatted before
+    for (b = 0; b < FTL_BLOCKS; b++)
+    {
+        flashSPAN_Read(blockAddress(b), (uint8_t *)&hdr, offsetof(ftlHeader_t, seq));
+        EraseCount[b] = (hdr.magic == FTL_MAGIC) ? hdr.eraseCount : 0;
+        res = eraseBlock(b);
+        if (res != RES_OK)
+        {
+            return(res);
+        }
+    }
+    return(flashFTL_Mount());
+}
+
+//--------------------------------------------------------------------------------------------------
+RES_t flashFTL_Mount(void)
+{
+    ftlHeader_t hdr;
+    uint16_t b;
+    uint16_t p;
+    uint16_t s;
+    uint16_t cur;
+    uint16_t newest = BLOCK_NONE;
+    uint16_t formatted = 0;
+    RES_t res;
+
+    Mounted = 0;
+    if (((FTL_FIRST_BLOCK + FTL_BLOCKS) > flashSPAN.BlockCount) || (sizeof(hdr) > FTL_SECTOR_SIZE)
+        || (((uint32_t)FTL_BLOCKS * FTL_DATA_PAGES) >= PAGE_NONE))
+    {
+        return(RES_PARAMERR);
+    }
+
+    memset(Map, 0xFF, sizeof(Map));
+    memset(&Stats, 0, sizeof(Stats));
+    FreeBlocks = 0;
+    OpenBlock = BLOCK_NONE;
+    Victim = BLOCK_NONE;
+    NextSeq = 0;
+
+    for (b = 0; b < FTL_BLOCKS; b++)
+    {
+        flashSPAN_Read(blockAddress(b), (uint8_t *)&hdr, sizeof(hdr));
+        Valid[b] = 0;
+        Seq[b] = SEQ_NONE;
+        if (hdr.magic != FTL_MAGIC)
+        {
+            State[b] = BLK_DIRTY;
+            EraseCount[b] = 0;
+            continue;
+        }
+        formatted++;
+        EraseCount[b] = hdr.eraseCount;
+        if (hdr.seq == SEQ_NONE)
+        {
+            State[b] = BLK_FREE;
+            FreeBlocks++;
+            continue;
+        }
+
+        // Only the newest block can have been open. It is resumed once all blocks are known.
+        State[b] = BLK_USED;
+        Seq[b] = hdr.seq;
+        if (hdr.seq >= NextSeq)
+        {
+            NextSeq = hdr.seq + 1;
+            newest = b;
+        }
+
+        // Newer blocks, and later pages in the same block, hold the newer copy
+        for (p = 0; p < FTL_DATA_PAGES; p++)
+        {
+            s = hdr.sector[p];
+            if (s >= FTL_SECTOR_COUNT)
+            {
+                continue;
+            }
+            cur = Map[s];
+            if ((cur == PAGE_NONE) || (Seq[cur / FTL_DATA_PAGES] <= hdr.seq))
+            {
+                Map[s] = b * FTL_DATA_PAGES + p;
+            }
+        }
+    }
+
+    if (formatted == 0)
+    {
+        return(RES_NOTFOUND);
+    }
+
+    for (s = 0; s < FTL_SECTOR_COUNT; s++)
+    {
+        if (Map[s] != PAGE_NONE)
+        {
+            Valid[Map[s] / FTL_DATA_PAGES]++;
+        }
+    }
+    for (b = 0; b < FTL_BLOCKS; b++)
+    {
+        if (State[b] == BLK_DIRTY)
+        {
+            res = eraseBlock(b);
+            if (res != RES_OK)
+            {
+                return(res);
+            }
+        }
+    }
+    if (newest != BLOCK_NONE)
+    {
+        resumeBlock(newest);
+    }
+
+    Mounted = 1;
+    return(RES_OK);
+}
+
+//--------------------------------------------------------------------------------------------------
+RES_t flashFTL_Read(uint16_t sector, uint8_t *data)
+{
+    if (!Mounted)
+    {
+        return(RES_INVALID);
+    }
+    if (sector >= FTL_SECTOR_COUNT)
+    {
+        return(RES_PARAMERR);
+    }
+    if (Map[sector] == PAGE_NONE)
+    {
+        memset(data, 0xFF, FTL_SECTOR_SIZE);
+        return(RES_OK);
+    }
+    return(flashSPAN_Read(pageAddress(Map[sector]), data, FTL_SECTOR_SIZE));
+}
+
+//--------------------------------------------------------------------------------------------------
+RES_t flashFTL_Write(uint16_t sector, uint8_t *data)
+{
+    uint16_t page;
+    RES_t res;
+
+    if (!Mounted)
+    {
+        return(RES_INVALID);
+    }
+    if (sector >= FTL_SECTOR_COUNT)
+    {
+        return(RES_PARAMERR);
+    }
+
+    res = allocPage(0, &page);
+    if (res != RES_OK)
+    {
+        return(res);
+    }
+    flashSPAN_Write(pageAddress(page), data, FTL_SECTOR_SIZE);
+    commitPage(sector, page);
+    Stats.hostWrites++;
+    return(RES_OK);
+}
+
+//--------------------------------------------------------------------------------------------------
+uint8_t flashFTL_Service(void)
+{
+    if (!Mounted || ((Victim == BLOCK_NONE) && (FreeBlocks >= FTL_GC_BACKGROUND)))
+    {
+        return(0);
+    }
+    if (collectStep() != RES_OK)
+    {
+        return(0);
+    }
+    return(((Victim != BLOCK_NONE) || (FreeBlocks < FTL_GC_BACKGROUND)) ? 1 : 0);
+}
+
+//--------------------------------------------------------------------------------------------------
+const flashFTL_stats_t* flashFTL_GetStats(void)
+{
+    uint16_t b;
+
+    Stats.minErase = 0xFFFFFFFFUL;
+    Stats.maxErase = 0;
+    Stats.eraseSum = 0;
+    for (b = 0; b < FTL_BLOCKS; b++)
+    {
+        if (EraseCount[b] < Stats.minErase)
+        {
+            Stats.minErase = EraseCount[b];
+        }
+        if (EraseCount[b] > Stats.maxErase)
+        {
+            Stats.maxErase = EraseCount[b];
+        }
+        Stats.eraseSum += EraseCount[b];
+    }
+    Stats.freeBlocks = FreeBlocks;
+    return(&Stats);
+}
+
+///\}
@@ -0,0 +1,168 @@
+/*
+* Copyright (c) 2012, Alexander I. Mykyta
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+* ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/**
+* \addtogroup MOD_FLASHFTL Flash Translation Layer
+* \brief Logical sectors with out-of-place writes and wear leveling on a FlashSPAN volume
+*
+* Manages #FTL_BLOCKS volume blocks as an array of #FTL_SECTOR_COUNT logical sectors. Every write
+* goes to the next free sector slot (page) of the open block, and the previous copy of the sector
+* becomes stale. No write waits for an erase unless the free blocks run out. \n \n
+*
+* The first page of each block is a header with the block's erase count, a sequence number that
+* orders the blocks by the time they were opened, and the logical sector number of each page. The
+* sector number is programmed after the page data, so a page torn by a power loss is ignored.
+* flashFTL_Mount() rebuilds the mapping table from the headers; the newest copy of each sector
+* wins. \n \n
+*
+* Garbage collection picks the closed block with the fewest valid pages, moves those pages to the
+* open block and erases it. New blocks are taken from the free block with the lowest erase count,
+* and blocks that hold cold data are reclaimed once they fall #FTL_WEAR_DELTA erases behind. \n
+* The only RAM table per sector is a 2-byte physical page number.
+*
+* This module requires the following module:
+*    - \ref MOD_FLASHSPAN "Spanned Flash Memory Volume"
+*
+* \{
+**/
+
+/**
+* \file
+* \brief Include file for \ref MOD_FLASHFTL "Flash Translation Layer"
+**/
+
+#ifndef _FLASHFTL_H_
+#define _FLASHFTL_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include "result.h"
+#include "FlashSPAN.h"
+#include "FlashFTL_config.h"
+
+//==================================================================================================
+// Defines
+//==================================================================================================
+
+/// Pages per block, including the header page
+#define FTL_PAGES_PER_BLOCK     (FLASH_VOLUME_BLOCKSIZE / FTL_SECTOR_SIZE)
+
+/// Data pages per block
+#define FTL_DATA_PAGES          (FTL_PAGES_PER_BLOCK - 1)
+
+/// Number of logical sectors
+#define FTL_SECTOR_COUNT        ((FTL_BLOCKS - FTL_RESERVE_BLOCKS) * FTL_DATA_PAGES)
+
+//==================================================================================================
+// Types
+//==================================================================================================
+
+    ///\brief FTL statistics
+    typedef struct
+    {
+        uint32_t hostWrites;    ///< Sectors written by flashFTL_Write()
+        uint32_t pageWrites;    ///< Pages programmed, including the moves of garbage collection
+        uint32_t relocations;   ///< Pages moved by garbage collection
+        uint32_t erases;        ///< Blocks erased since flashFTL_Mount()
+        uint32_t minErase;      ///< Lowest erase count of any block
+        uint32_t maxErase;      ///< Highest erase count of any block
+        uint32_t eraseSum;      ///< Sum of the erase counts of all blocks
+        uint16_t freeBlocks;    ///< Erased blocks ready to be opened
+    } flashFTL_stats_t;
+
+//==================================================================================================
+// Function Prototypes
+//==================================================================================================
+
+    /**
+    * \brief Erase all FTL blocks and mount the empty FTL. Erase counts are kept.
+    * \retval RES_OK
+    * \retval RES_PARAMERR The configuration does not fit the volume
+    **/
+    RES_t flashFTL_Format(void);
+
+    /**
+    * \brief Rebuild the mapping table from the block headers
+    * \retval RES_OK
+    * \retval RES_NOTFOUND The blocks were never formatted
+    * \retval RES_PARAMERR The configuration does not fit the volume
+    *
+    * Blocks with an invalid header, e.g. from a power loss during an erase, are erased. Their
+    * erase count restarts at 0. The newest block is opened again at its first blank page after
+    * the last committed one. flashSPAN_Init() must have been called first.
+    **/
+    RES_t flashFTL_Mount(void);
+
+    /**
+    * \brief Read a logical sector
+    * \param [in] sector Sector number, less than #FTL_SECTOR_COUNT
+    * \param [out] data #FTL_SECTOR_SIZE bytes. All 0xFF if the sector was never written.
+    * \retval RES_OK
+    * \retval RES_PARAMERR Invalid sector
+    * \retval RES_INVALID Not mounted
+    **/
+    RES_t flashFTL_Read(uint16_t sector, uint8_t *data);
+
+    /**
+    * \brief Write a logical sector
+    * \param [in] sector Sector number, less than #FTL_SECTOR_COUNT
+    * \param [in] data #FTL_SECTOR_SIZE bytes
+    * \retval RES_OK
+    * \retval RES_PARAMERR Invalid sector
+    * \retval RES_INVALID Not mounted
+    * \retval RES_FULL No block could be reclaimed
+    *
+    * Reclaims blocks itself only when a new block is needed and just one is free. Otherwise the
+    * write is a single program of the sector and its header entry.
+    **/
+    RES_t flashFTL_Write(uint16_t sector, uint8_t *data);
+
+    /**
+    * \brief Do one step of background garbage collection
+    * \return 1 while there is more to do. 0 when at least #FTL_GC_BACKGROUND blocks are free or
+    *         nothing can be reclaimed.
+    *
+    * A step moves one valid page or erases one block. Call it while the application is idle to
+    * keep the erases out of flashFTL_Write().
+    **/
+    uint8_t flashFTL_Service(void);
+
+    /**
+    * \brief Get a pointer to the FTL statistics
+    *
+    * The erase count fields and \c freeBlocks are updated by this call. The write amplification
+    * is \c pageWrites / \c hostWrites.
+    **/
+    const flashFTL_stats_t* flashFTL_GetStats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+///\}
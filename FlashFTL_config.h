@@ -0,0 +1,46 @@
+/**
+* \addtogroup MOD_FLASHFTL
+* \{
+**/
+
+/**
+* \file
+* \brief Configuration include file for \ref MOD_FLASHFTL "Flash Translation Layer"
+**/
+
+#ifndef _FLASHFTL_CONFIG_H_
+#define _FLASHFTL_CONFIG_H_
+
+//==================================================================================================
+/// \name Configuration
+/// Configuration defines for the \ref MOD_FLASHFTL module
+/// \{
+//==================================================================================================
+
+/// First \ref MOD_FLASHSPAN "FlashSPAN" volume block managed by the FTL
+#define FTL_FIRST_BLOCK         0 ///< \hideinitializer
+
+/// Number of volume blocks managed by the FTL. RAM use is about 10 bytes per block plus 2 bytes
+/// per sector.
+#define FTL_BLOCKS              64 ///< \hideinitializer
+
+/// Blocks kept free of logical sectors (over-provisioning). At least 2. More reserve blocks lower
+/// the write amplification.
+#define FTL_RESERVE_BLOCKS      8 ///< \hideinitializer
+
+/// Sector size in bytes. A power of 2 that divides #FLASH_VOLUME_BLOCKSIZE. The first sector of
+/// every block holds the block header.
+#define FTL_SECTOR_SIZE         512 ///< \hideinitializer
+
+/// flashFTL_Service() reclaims blocks while fewer than this many are free
+#define FTL_GC_BACKGROUND       4 ///< \hideinitializer
+
+/// Static wear leveling: once the most worn block has been erased this many times more than the
+/// least worn block holding data, that block's data is moved so the block can be reused.
+#define FTL_WEAR_DELTA          16 ///< \hideinitializer
+
+///\}
+
+#endif
+
+///\}
@@ -0,0 +1,490 @@
+/*
+* Copyright (c) 2012, Alexander I. Mykyta
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+* ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/**
+* \addtogroup MOD_FLASHLOG
+* \{
+**/
+
+/**
+* \file
+* \brief Code for \ref MOD_FLASHLOG "Flash Record Log"
+**/
+
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __MSP430__
+#include <msp430.h>
+#endif
+#include "FlashSPAN.h"
+#include "FlashLog.h"
+
+//==================================================================================================
+// Internal Functions
+//==================================================================================================
+///\cond INTERNAL
+
+#if LOG_ERASE_AHEAD < 1
+#error "LOG_ERASE_AHEAD must be at least 1"
+#endif
+#if (LOG_MAX_RECORD < 1) || ((LOG_MAX_RECORD + 12) > FLASH_BLOCKSIZE)
+#error "LOG_MAX_RECORD does not fit in a block"
+#endif
+
+#define LOG_MAGIC       0x474C
+#define CRC_INIT        0xFFFF
+
+// Bytes read per flashSPAN call when a record is checked
+#define CHECK_CHUNK     32
+
+// Block header, written when the block becomes the head
+typedef struct
+{
+    uint16_t magic;
+    uint16_t check;     // CRC of seq
+    uint32_t seq;
+} logBlockHeader_t;
+
+// Record header. The CRC covers the length and the data.
+typedef struct
+{
+    uint16_t length;
+    uint16_t crc;
+} logRecordHeader_t;
+
+static uint32_t Blocks;
+static uint32_t HeadSeq;
+static uint32_t HeadOffset;     // where the next record goes in the head block
+static uint32_t TailSeq;
+static uint32_t Ahead;          // erased blocks after the head
+static uint8_t Mounted;
+static flashLog_stats_t Stats;
+
+//--------------------------------------------------------------------------------------------------
+// CRC-16/CCITT. Uses the CRC16 module on the MSP430.
+static uint16_t crc16(uint16_t crc, const uint8_t *data, uint16_t nBytes)
+{
+#ifdef __MSP430__
+    CRCINIRES = crc;
+    while (nBytes--)
+    {
+        CRCDIRB_L = *data++;
+    }
+    return(CRCINIRES);
+#else
+    uint8_t i;
+
+    while (nBytes--)
+    {
+        crc ^= (uint16_t)(*data++) << 8;
+        for (i = 0; i < 8; i++)
+        {
+            crc = (crc & 0x8000) ? ((crc << 1) ^ 0x1021) : (crc << 1);
+        }
+    }
+    return(crc);
+#endif
+}
+
+//--------------------------------------------------------------------------------------------------
+// Volume address of the block that holds a sequence number
+static uint32_t blockAddress(uint32_t seq)
+{
+    return((LOG_FIRST_BLOCK + seq % Blocks) * FLASH_VOLUME_BLOCKSIZE);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Reads the header of a block. Returns 1 if it is valid and belongs to that block.
+static uint8_t readHeader(uint32_t block, uint32_t *seq)
+{
+    logBlockHeader_t hdr;
+
+    flashSPAN_Read((LOG_FIRST_BLOCK + block) * FLASH_VOLUME_BLOCKSIZE, (uint8_t *)&hdr,
+                   sizeof(hdr));
+    Stats.mountReads++;
+    if ((hdr.magic != LOG_MAGIC) || (hdr.check != crc16(CRC_INIT, (uint8_t *)&hdr.seq, 4))
+        || ((hdr.seq % Blocks) != block))
+    {
+        return(0);
+    }
+    *seq = hdr.seq;
+    return(1);
+}
+
+//--------------------------------------------------------------------------------------------------
+// CRC of a record's data, read from the volume in chunks
+static uint16_t recordCRC(uint32_t address, const logRecordHeader_t *rec)
+{
+    uint8_t buf[CHECK_CHUNK];
+    uint16_t crc;
+    uint16_t n;
+    uint16_t left;
+
+    crc = crc16(CRC_INIT, (uint8_t *)&rec->length, 2);
+    for (left = rec->length; left; left -= n)
+    {
+        n = (left < CHECK_CHUNK) ? left : CHECK_CHUNK;
+        flashSPAN_Read(address, buf, n);
+        crc = crc16(crc, buf, n);
+        address += n;
+    }
+    return(crc);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Checks the configuration and clears the state
+static RES_t setup(void)
+{
+    Mounted = 0;
+    memset(&Stats, 0, sizeof(Stats));
+#if LOG_BLOCKS
+    Blocks = LOG_BLOCKS;
+#else
+    Blocks = (flashSPAN.BlockCount > LOG_FIRST_BLOCK) ? (flashSPAN.BlockCount - LOG_FIRST_BLOCK)
+                                                      : 0;
+#endif
+    if (((LOG_FIRST_BLOCK + Blocks) > flashSPAN.BlockCount) || (Blocks < (LOG_ERASE_AHEAD + 2)))
+    {
+        return(RES_PARAMERR);
+    }
+    return(RES_OK);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Erases the block of a sequence number. The records it held from the previous pass are dropped.
+static RES_t eraseBlock(uint32_t seq)
+{
+    RES_t res;
+
+    res = flashSPAN_EraseBlock(LOG_FIRST_BLOCK + seq % Blocks);
+    if (res != RES_OK)
+    {
+        return(res);
+    }
+    Stats.erases++;
+    if ((seq >= Blocks) && ((seq - Blocks) >= TailSeq))
+    {
+        TailSeq = seq - Blocks + 1;
+        Stats.dropped++;
+    }
+    return(RES_OK);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Makes the next block the head
+static RES_t openNext(void)
+{
+    logBlockHeader_t hdr;
+    RES_t res;
+
+    hdr.seq = HeadSeq + 1;
+    if (Ahead)
+    {
+        Ahead--;
+    }
+    else
+    {
+        res = eraseBlock(hdr.seq);
+        if (res != RES_OK)
+        {
+            return(res);
+        }
+        Stats.syncErases++;
+    }
+
+    hdr.magic = LOG_MAGIC;
+    hdr.check = crc16(CRC_INIT, (uint8_t *)&hdr.seq, 4);
+    flashSPAN_Write(blockAddress(hdr.seq), (uint8_t *)&hdr, sizeof(hdr));
+    HeadSeq = hdr.seq;
+    HeadOffset = sizeof(hdr);
+    return(RES_OK);
+}
+
+///\endcond
+//==================================================================================================
+// Functions
+//==================================================================================================
+
+//--------------------------------------------------------------------------------------------------
+RES_t flashLog_Format(void)
+{
+    RES_t res;
+
+    res = setup();
+    if (res != RES_OK)
+    {
+        return(res);
+    }
+    res = flashSPAN_EraseRange(blockAddress(0), Blocks * FLASH_VOLUME_BLOCKSIZE);
+    if (res != RES_OK)
+    {
+        return(res);
+    }
+
+    HeadSeq = 0xFFFFFFFFUL;
+    TailSeq = 0;
+    Ahead = Blocks;
+    res = openNext();
+    if (res != RES_OK)
+    {
+        return(res);
+    }
+    Mounted = 1;
+    return(RES_OK);
+}
+
+//--------------------------------------------------------------------------------------------------
+RES_t flashLog_Mount(void)
+{
+    logBlockHeader_t hdr;
+    logRecordHeader_t rec;
+    uint32_t address;
+    uint32_t last = 0;
+    uint32_t seq = 0;
+    uint32_t lap;
+    uint32_t lo;
+    uint32_t hi;
+    uint32_t mid;
+    uint32_t n;
+    RES_t res;
+
+    res = setup();
+    if (res != RES_OK)
+    {
+        return(res);
+    }
+
+    // Only erased blocks ahead of the head, and a block torn while being erased or opened, can
+    // come before the first valid block
+    for (lo = 0; lo < (LOG_ERASE_AHEAD + 2); lo++)
+    {
+        if (readHeader(lo, &seq))
+        {
+            break;
+        }
+    }
+    if (lo == (LOG_ERASE_AHEAD + 2))
+    {
+        return(RES_NOTFOUND);
+    }
+
+    // The blocks from there to the head were written in the same pass. The blocks after it are
+    // erased or from the previous pass.
+    lap = seq / Blocks;
+    HeadSeq = seq;
+    hi = Blocks;
+    while ((hi - lo) > 1)
+    {
+        mid = lo + (hi - lo) / 2;
+        if (readHeader(mid, &seq) && ((seq / Blocks) == lap))
+        {
+            lo = mid;
+            HeadSeq = seq;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+
+    // The tail is the first valid block after the head. Before the first wrap-around, the blocks
+    // after the head were never written.
+    lo = ((HeadSeq + 1) < Blocks) ? 0 : ((HeadSeq + 1) % Blocks);
+    TailSeq = HeadSeq;
+    for (n = 0; n < Blocks; n++)
+    {
+        if (readHeader((lo + n) % Blocks, &seq) && (seq <= HeadSeq))
+        {
+            TailSeq = seq;
+            break;
+        }
+    }
+
+    // Blocks after the head that were erased by a format are still blank. Others are erased
+    // again before use, since their erase may have been cut short.
+    Ahead = 0;
+    if ((HeadSeq + 1) < Blocks)
+    {
+        flashSPAN_Read(blockAddress(HeadSeq + 1), (uint8_t *)&hdr, sizeof(hdr));
+        Stats.mountReads++;
+        if ((hdr.magic == 0xFFFF) && (hdr.check == 0xFFFF) && (hdr.seq == 0xFFFFFFFFUL))
+        {
+            Ahead = Blocks - 1 - HeadSeq;
+        }
+    }
+
+    // Walk the records of the head block to find its end
+    address = blockAddress(HeadSeq);
+    HeadOffset = sizeof(hdr);
+    while ((HeadOffset + sizeof(rec)) <= FLASH_VOLUME_BLOCKSIZE)
+    {
+        flashSPAN_Read(address + HeadOffset, (uint8_t *)&rec, sizeof(rec));
+        if ((rec.length == 0xFFFF) && (rec.crc == 0xFFFF))
+        {
+            break;
+        }
+        if ((rec.length == 0) || (rec.length > LOG_MAX_RECORD)
+            || ((HeadOffset + sizeof(rec) + rec.length) > FLASH_VOLUME_BLOCKSIZE))
+        {
+            HeadOffset = FLASH_VOLUME_BLOCKSIZE;
+            break;
+        }
+        last = HeadOffset;
+        HeadOffset += sizeof(rec) + rec.length;
+    }
+
+    // A torn last record closes the head block. The next append starts a new one.
+    if (last && (HeadOffset < FLASH_VOLUME_BLOCKSIZE))
+    {
+        flashSPAN_Read(address + last, (uint8_t *)&rec, sizeof(rec));
+        if (recordCRC(address + last + sizeof(rec), &rec) != rec.crc)
+        {
+            HeadOffset = FLASH_VOLUME_BLOCKSIZE;
+        }
+    }
+
+    Mounted = 1;
+    return(RES_OK);
+}
+
+//--------------------------------------------------------------------------------------------------
+RES_t flashLog_Append(uint8_t *data, uint16_t nBytes)
+{
+    logRecordHeader_t rec;
+    flashSPAN_iovec_t iov[2];
+    RES_t res;
+
+    if (!Mounted)
+    {
+        return(RES_INVALID);
+    }
+    if ((nBytes == 0) || (nBytes > LOG_MAX_RECORD))
+    {
+        return(RES_PARAMERR);
+    }
+
+    if ((HeadOffset + sizeof(rec) + nBytes) > FLASH_VOLUME_BLOCKSIZE)
+    {
+        res = openNext();
+        if (res != RES_OK)
+        {
+            return(res);
+        }
+    }
+
+    rec.length = nBytes;
+    rec.crc = crc16(crc16(CRC_INIT, (uint8_t *)&rec.length, 2), data, nBytes);
+    iov[0].data = (uint8_t *)&rec;
+    iov[0].nBytes = sizeof(rec);
+    iov[1].data = data;
+    iov[1].nBytes = nBytes;
+    res = flashSPAN_WriteV(blockAddress(HeadSeq) + HeadOffset, iov, 2);
+    if (res != RES_OK)
+    {
+        return(res);
+    }
+    HeadOffset += sizeof(rec) + nBytes;
+    Stats.appends++;
+    return(RES_OK);
+}
+
+//--------------------------------------------------------------------------------------------------
+uint8_t flashLog_Service(void)
+{
+    if (!Mounted || (Ahead >= LOG_ERASE_AHEAD))
+    {
+        return(0);
+    }
+    if (eraseBlock(HeadSeq + 1 + Ahead) != RES_OK)
+    {
+        return(0);
+    }
+    Ahead++;
+    return((Ahead < LOG_ERASE_AHEAD) ? 1 : 0);
+}
+
+//--------------------------------------------------------------------------------------------------
+void flashLog_Rewind(flashLog_cursor_t *cur)
+{
+    cur->seq = TailSeq;
+    cur->offset = sizeof(logBlockHeader_t);
+}
+
+//--------------------------------------------------------------------------------------------------
+RES_t flashLog_ReadNext(flashLog_cursor_t *cur, uint8_t *data, uint16_t *nBytes)
+{
+    logRecordHeader_t rec;
+    uint32_t address;
+
+    if (!Mounted)
+    {
+        return(RES_INVALID);
+    }
+
+    for (;;)
+    {
+        if (cur->seq < TailSeq)
+        {
+            flashLog_Rewind(cur);
+        }
+        if ((cur->seq > HeadSeq) || ((cur->seq == HeadSeq) && (cur->offset >= HeadOffset)))
+        {
+            return(RES_NOTFOUND);
+        }
+
+        address = blockAddress(cur->seq) + cur->offset;
+        if ((cur->offset + sizeof(rec)) <= FLASH_VOLUME_BLOCKSIZE)
+        {
+            flashSPAN_Read(address, (uint8_t *)&rec, sizeof(rec));
+            if ((rec.length != 0) && (rec.length <= LOG_MAX_RECORD)
+                && ((cur->offset + sizeof(rec) + rec.length) <= FLASH_VOLUME_BLOCKSIZE))
+            {
+                break;
+            }
+        }
+
+        // No more records in this block
+        cur->seq++;
+        cur->offset = sizeof(logBlockHeader_t);
+    }
+
+    flashSPAN_Read(address + sizeof(rec), data, rec.length);
+    cur->offset += sizeof(rec) + rec.length;
+    *nBytes = rec.length;
+    if (crc16(crc16(CRC_INIT, (uint8_t *)&rec.length, 2), data, rec.length) != rec.crc)
+    {
+        return(RES_FAIL);
+    }
+    return(RES_OK);
+}
+
+//--------------------------------------------------------------------------------------------------
+const flashLog_stats_t* flashLog_GetStats(void)
+{
+    return(&Stats);
+}
+
+///\}
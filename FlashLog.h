@@ -0,0 +1,162 @@
+/*
+* Copyright (c) 2012, Alexander I. Mykyta
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+* ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/**
+* \addtogroup MOD_FLASHLOG Flash Record Log
+* \brief Append-only log of variable length records on a FlashSPAN volume
+*
+* Records are appended one after the other into blocks that were erased in advance, so an append
+* is a single program of the record header and data. The blocks are used as a ring: when the
+* head reaches the end of the log it wraps around, and flashLog_Service() erases the oldest block
+* to make room. The records in that block are lost. \n \n
+*
+* Every block starts with a header that holds its sequence number. Block n of the log only ever
+* holds sequence numbers that equal n modulo the block count, so the block with the newest
+* sequence number is the last one, in address order, that was written in the same pass as block
+* 0. flashLog_Mount() finds it with a binary search over the block headers and then walks the
+* records of that block only. Mount time grows with the log of the block count. \n \n
+*
+* Each record has a 4-byte header with its length and a CRC-16 of the length and data. A record
+* torn by a power loss fails its CRC, and the next append starts a new block.
+*
+* This module requires the following module:
+*    - \ref MOD_FLASHSPAN "Spanned Flash Memory Volume"
+*
+* \{
+**/
+
+/**
+* \file
+* \brief Include file for \ref MOD_FLASHLOG "Flash Record Log"
+**/
+
+#ifndef _FLASHLOG_H_
+#define _FLASHLOG_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include "result.h"
+#include "FlashSPAN.h"
+#include "FlashLog_config.h"
+
+//==================================================================================================
+// Types
+//==================================================================================================
+
+    ///\brief Position of a reader in the log
+    typedef struct
+    {
+        uint32_t seq;       ///< Sequence number of the block
+        uint32_t offset;    ///< Offset of the next record in the block
+    } flashLog_cursor_t;
+
+    ///\brief Log statistics
+    typedef struct
+    {
+        uint32_t appends;       ///< Records written by flashLog_Append()
+        uint32_t erases;        ///< Blocks erased since flashLog_Mount() or flashLog_Format()
+        uint32_t syncErases;    ///< Erases that flashLog_Append() had to do itself
+        uint32_t dropped;       ///< Blocks of records lost to wrap-around
+        uint16_t mountReads;    ///< Block headers read by the last flashLog_Mount()
+    } flashLog_stats_t;
+
+//==================================================================================================
+// Function Prototypes
+//==================================================================================================
+
+    /**
+    * \brief Erase the log and mount it empty
+    * \retval RES_OK
+    * \retval RES_PARAMERR The configuration does not fit the volume
+    **/
+    RES_t flashLog_Format(void);
+
+    /**
+    * \brief Find the head and tail of the log
+    * \retval RES_OK
+    * \retval RES_NOTFOUND The log was never formatted
+    * \retval RES_PARAMERR The configuration does not fit the volume
+    *
+    * Reads about log2 of the block count plus 2 * #LOG_ERASE_AHEAD block headers, and the record
+    * headers of the newest block. Blocks ahead of the head that may hold a cut-short erase are
+    * erased again before use. flashSPAN_Init() must have been called first.
+    **/
+    RES_t flashLog_Mount(void);
+
+    /**
+    * \brief Append a record
+    * \param [in] data Record data
+    * \param [in] nBytes Record length, 1 to #LOG_MAX_RECORD
+    * \retval RES_OK
+    * \retval RES_PARAMERR Invalid length
+    * \retval RES_INVALID Not mounted
+    *
+    * If the record does not fit in the rest of the head block, it goes to the next block. That
+    * block is erased here only if flashLog_Service() has not erased it already.
+    **/
+    RES_t flashLog_Append(uint8_t *data, uint16_t nBytes);
+
+    /**
+    * \brief Erase the next block ahead of the head
+    * \return 1 while fewer than #LOG_ERASE_AHEAD blocks are erased. 0 otherwise.
+    *
+    * Call it while the application is idle to keep the erases out of flashLog_Append().
+    **/
+    uint8_t flashLog_Service(void);
+
+    /**
+    * \brief Point a cursor at the oldest record
+    **/
+    void flashLog_Rewind(flashLog_cursor_t *cur);
+
+    /**
+    * \brief Read the record at a cursor and advance it
+    * \param [in,out] cur Cursor from flashLog_Rewind()
+    * \param [out] data #LOG_MAX_RECORD bytes
+    * \param [out] nBytes Record length
+    * \retval RES_OK
+    * \retval RES_NOTFOUND No more records
+    * \retval RES_FAIL The record failed its CRC. The cursor is advanced past it.
+    * \retval RES_INVALID Not mounted
+    *
+    * A cursor that falls behind the tail because its block was erased continues at the oldest
+    * record.
+    **/
+    RES_t flashLog_ReadNext(flashLog_cursor_t *cur, uint8_t *data, uint16_t *nBytes);
+
+    /**
+    * \brief Get a pointer to the log statistics
+    **/
+    const flashLog_stats_t* flashLog_GetStats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+///\}
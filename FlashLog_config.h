@@ -0,0 +1,38 @@
+/**
+* \addtogroup MOD_FLASHLOG
+* \{
+**/
+
+/**
+* \file
+* \brief Configuration include file for \ref MOD_FLASHLOG "Flash Record Log"
+**/
+
+#ifndef _FLASHLOG_CONFIG_H_
+#define _FLASHLOG_CONFIG_H_
+
+//==================================================================================================
+/// \name Configuration
+/// Configuration defines for the \ref MOD_FLASHLOG module
+/// \{
+//==================================================================================================
+
+/// First \ref MOD_FLASHSPAN "FlashSPAN" volume block used by the log
+#define LOG_FIRST_BLOCK         0 ///< \hideinitializer
+
+/// Number of volume blocks used by the log. At least #LOG_ERASE_AHEAD + 2.
+#define LOG_BLOCKS              0 ///< \hideinitializer
+/**<    0 = All blocks from #LOG_FIRST_BLOCK to the end of the volume **/
+
+/// Largest record in bytes. Must fit in a block together with the block and record headers.
+#define LOG_MAX_RECORD          256 ///< \hideinitializer
+
+/// flashLog_Service() keeps this many blocks ahead of the head erased. The oldest records are
+/// dropped when their block is erased.
+#define LOG_ERASE_AHEAD         1 ///< \hideinitializer
+
+///\}
+
+#endif
+
+///\}
@@ -30,7 +30,10 @@
 *
 * This module merges several similar smaller Flash memories into one large virtual device with a
 * continuous address space. This module defines a generic interface which can implement a
-* variety of memory devices.
+* variety of memory devices. \n \n
+*
+* By default the devices are concatenated. #FLASH_STRIPE_SIZE interleaves them instead, so that
+* writes program all devices at once, and #FLASH_MIRROR keeps a copy of the volume on every device.
 *
 * \{
 **/
@@ -52,20 +55,108 @@ extern "C" {
 #include "result.h"
 #include "FlashSPAN_config.h"
 
+/// Size of a volume block. With #FLASH_STRIPE_SIZE, a volume block is the same block of every device.
+#if FLASH_STRIPE_SIZE
+#define FLASH_VOLUME_BLOCKSIZE  ((uint32_t)FLASH_BLOCKSIZE * FLASH_DEVICECOUNT)
+#else
+#define FLASH_VOLUME_BLOCKSIZE  FLASH_BLOCKSIZE
+#endif
+
 ///\brief Data object that stores information about the spanned flash volume.
     typedef struct
     {
-        uint16_t DeviceBlocks[FLASH_DEVICECOUNT]; ///< Array of block counts for each device
-        uint16_t BlockCount; ///< Total volume block count
+        uint32_t DeviceBlocks[FLASH_DEVICECOUNT]; ///< Array of block counts for each device
+        uint32_t BlockCount; ///< Total volume block count (blocks of #FLASH_VOLUME_BLOCKSIZE)
+        uint32_t LastEraseMs; ///< Estimated duration of the last flashSPAN_EraseRange() in ms
+        uint32_t LastEraseSavedMs; ///< Estimated time the last flashSPAN_EraseRange() saved over
+                                   ///< erasing the same range block by block, in ms
     } flashSPAN_t;
 
+///\brief One segment of a vectored transfer
+    typedef struct
+    {
+        uint8_t *data;      ///< Segment buffer
+        uint16_t nBytes;    ///< Segment length. May be 0.
+    } flashSPAN_iovec_t;
+
+#if FLASH_ASYNC
+/// \name Request Operations
+/// \brief Values of flashSPAN_req_t::op
+///\{
+#define FLASH_OP_READ       0   ///< Read \c nBytes into \c data
+#define FLASH_OP_WRITE      1   ///< Write \c nBytes from \c data
+#define FLASH_OP_ERASE      2   ///< Erase the block at \c address. \c data and \c nBytes are unused.
+#define FLASH_OP_COUNT      3
+///\}
+
+    typedef struct flashSPAN_req_s flashSPAN_req_t;
+
+    /**
+    * \brief Request completion callback
+    *
+    * Called from flashSPAN_Service(). May submit new requests, but must not call the blocking
+    * functions.
+    **/
+    typedef void (*flashSPAN_callback_t)(flashSPAN_req_t *req);
+
+    ///\brief Request descriptor. Owned by the module from flashSPAN_Submit() until completion.
+    struct flashSPAN_req_s
+    {
+        uint8_t op;                     ///< One of the \c FLASH_OP_x operations
+        uint32_t address;               ///< Volume address. Multiple of #FLASH_BLOCKSIZE for erases.
+        uint8_t *data;                  ///< Data buffer
+        uint16_t nBytes;                ///< Number of bytes to transfer
+        flashSPAN_callback_t callback;  ///< Completion callback. Can be \c NULL
+        void *context;                  ///< User context
+        RES_t result;                   ///< #RES_BUSY until completion, then the result
+        uint32_t devAddr;               ///< \private
+        uint16_t done;                  ///< \private
+        uint32_t submitTime;            ///< \private
+        flashSPAN_req_t *next;          ///< \private
+    };
+
+    ///\brief Request statistics. Times are in #FLASH_ASYNC_CLOCK() units.
+    typedef struct
+    {
+        uint8_t depth;                          ///< Requests submitted and not completed yet
+        uint8_t maxDepth;                       ///< Highest depth seen
+        uint32_t completed[FLASH_OP_COUNT];     ///< Completed requests of each operation
+        uint32_t latencySum[FLASH_OP_COUNT];    ///< Sum of submit-to-completion times
+        uint32_t latencyMax[FLASH_OP_COUNT];    ///< Longest submit-to-completion time
+        uint32_t busyTime[FLASH_DEVICECOUNT];   ///< Time each device had a request in progress
+        uint32_t startTime;                     ///< Time of the last flashSPAN_ClearAsyncStats()
+    } flashSPAN_asyncStats_t;
+#endif
+
+#if FLASH_CACHE_LINES
+    ///\brief Read cache statistics
+    typedef struct
+    {
+        uint32_t hits;          ///< Lines read from the cache
+        uint32_t misses;        ///< Lines read from the devices into the cache
+        uint32_t bypassed;      ///< Reads too large for the cache
+        uint32_t invalidated;   ///< Lines dropped by writes and erases
+    } flashSPAN_cacheStats_t;
+#endif
+
+#if FLASH_OVERWRITE
+    ///\brief flashSPAN_Overwrite() statistics. Counted per block touched.
+    typedef struct
+    {
+        uint32_t unchanged;     ///< Data was already in place. Nothing written.
+        uint32_t inPlace;       ///< Only 1 to 0 bit changes. Programmed without an erase.
+        uint32_t merged;        ///< Block read, erased and written back
+    } flashSPAN_overwriteStats_t;
+#endif
+
 ///\brief flashSPAN object is externally accessible for higher level modules
     extern flashSPAN_t flashSPAN;
 
     /**
     * \brief Initializes the spanned flash volume and populates the #flashSPAN object
     * \retval RES_OK
-    * \retval RES_FAIL
+    * \retval RES_FAIL A device did not respond, can not erase blocks of #FLASH_BLOCKSIZE, or
+    *         (with #FLASH_MIRROR) differs from device 0
     * \attention The initialization routine does \e not setup the IO ports!
     **/
     RES_t flashSPAN_Init(void);
@@ -77,6 +168,8 @@ extern "C" {
     * \param [out] data Data read
     * \retval RES_OK
     * \retval RES_PARAMERR Invalid address range
+    *
+    * With #FLASH_CACHE_LINES, small reads are served from the read cache where possible.
     **/
     RES_t flashSPAN_Read(uint32_t address, uint8_t *data, uint16_t nBytes);
 
@@ -90,20 +183,170 @@ extern "C" {
     **/
     RES_t flashSPAN_Write(uint32_t address, uint8_t *data, uint16_t nBytes);
 
+    /**
+    * \brief Read a contiguous range of the volume into several buffers
+    * \param [in] address Start address of read operation
+    * \param [in] iov Segments to fill, in address order. The total length may exceed 64 KB.
+    * \param [in] iovCount Number of segments
+    * \retval RES_OK
+    * \retval RES_PARAMERR Invalid address range
+    *
+    * Segments that follow each other on one device are read with a single read command.
+    **/
+    RES_t flashSPAN_ReadV(uint32_t address, const flashSPAN_iovec_t *iov, uint8_t iovCount);
+
+    /**
+    * \brief Write several buffers to a contiguous range of the volume
+    * \param [in] address Start address of write operation
+    * \param [in] iov Segments to write, in address order. The total length may exceed 64 KB.
+    * \param [in] iovCount Number of segments
+    * \retval RES_OK
+    * \retval RES_PARAMERR Invalid address range
+    *
+    * The segments are programmed as if they were one buffer. Page programs and AAI sequences
+    * continue across segment boundaries, so a record can be written from its header and payload
+    * without copying them together first.
+    **/
+    RES_t flashSPAN_WriteV(uint32_t address, const flashSPAN_iovec_t *iov, uint8_t iovCount);
+
+#if FLASH_OVERWRITE
+    /**
+    * \brief Write data to the Flash volume whether or not it is erased
+    * \param [in] address Start address of write operation
+    * \param [in] nBytes Number of bytes to be written
+    * \param [in] data Data to be written
+    * \retval RES_OK
+    * \retval RES_PARAMERR Invalid address range
+    *
+    * Compares the data with the contents of each block it touches. Where only 1 to 0 bit changes
+    * are needed, the bytes that differ are programmed in place. Otherwise the block is read into
+    * a shared buffer, merged with the data, erased and written back. Data outside the range is
+    * kept. Not reentrant.
+    **/
+    RES_t flashSPAN_Overwrite(uint32_t address, uint8_t *data, uint16_t nBytes);
+
+    /**
+    * \brief Get a pointer to the flashSPAN_Overwrite() statistics
+    **/
+    const flashSPAN_overwriteStats_t* flashSPAN_GetOverwriteStats(void);
+#endif
+
     /**
     * \brief Erase a block of Flash memory
-    * \param [in] block Block number
+    * \param [in] block Block number. Blocks are #FLASH_VOLUME_BLOCKSIZE bytes.
     * \retval RES_OK
     * \retval RES_PARAMERR Invalid address range
+    *
+    * With #FLASH_ERASE_BLANK_CHECK, blocks that are already blank are not erased.
     **/
-    RES_t flashSPAN_EraseBlock(uint16_t block);
+    RES_t flashSPAN_EraseBlock(uint32_t block);
+
+    /**
+    * \brief Erase a range of the Flash volume using the largest erase operations possible
+    * \param [in] start Start address. Must be a multiple of #FLASH_VOLUME_BLOCKSIZE.
+    * \param [in] length Number of bytes to erase. Must be a multiple of #FLASH_VOLUME_BLOCKSIZE.
+    * \retval RES_OK
+    * \retval RES_PARAMERR Invalid or unaligned address range
+    *
+    * The range may span several devices. Each device's part of the range is covered by aligned
+    * erases, largest first. All devices erase at the same time. Estimates based on typical erase
+    * times are left in flashSPAN_t::LastEraseMs and flashSPAN_t::LastEraseSavedMs (compared with
+    * erasing the range block by block, one device after the other).
+    **/
+    RES_t flashSPAN_EraseRange(uint32_t start, uint32_t length);
+
+    /**
+    * \brief Start erasing a range in the background
+    * \param [in] start Start address. Must be a multiple of #FLASH_VOLUME_BLOCKSIZE.
+    * \param [in] length Number of bytes to erase. Must be a multiple of #FLASH_VOLUME_BLOCKSIZE.
+    * \retval RES_OK
+    * \retval RES_PARAMERR Invalid or unaligned address range
+    * \retval RES_BUSY A background erase is still in progress
+    *
+    * Same as flashSPAN_EraseRange() but only the first erase of each device is started.
+    * flashSPAN_EraseService() must be called periodically to issue the rest.
+    *
+    * Reads may be done while the erase runs. If #FLASH_ERASE_SUSPEND is enabled, the erase of a
+    * device that supports it is suspended for the duration of the read. Other devices wait for
+    * their current erase command to finish. Writes and erases always wait. Data in the part of the
+    * range that is not erased yet is still readable, but must not be written.
+    **/
+    RES_t flashSPAN_EraseRangeStart(uint32_t start, uint32_t length);
+
+    /**
+    * \brief Continue a background erase
+    * \return 1 while the erase started by flashSPAN_EraseRangeStart() is in progress. 0 when done.
+    **/
+    uint8_t flashSPAN_EraseService(void);
 
     /**
     * \brief Erase the entire spanned flash volume
     * \retval RES_OK
+    *
+    * All devices erase at the same time.
     **/
     RES_t flashSPAN_EraseAll(void);
 
+#if FLASH_ASYNC
+    /**
+    * \brief Queue a request
+    * \param [in] req Request descriptor. Must stay valid until it has completed.
+    * \retval RES_OK Queued. flashSPAN_req_t::result is #RES_BUSY until completion.
+    * \retval RES_PARAMERR Invalid operation or address range, a range that crosses a device
+    *                      boundary, or an unaligned erase
+    *
+    * Each device has its own queue and works on one request at a time. Devices are independent,
+    * so a read on one device does not wait for a program or erase on another. The queue of a
+    * device is served in ascending address order from the last address, wrapping around to the
+    * lowest (C-SCAN). Requests to the same address are served in submission order; requests whose
+    * ranges only overlap are not ordered. \n
+    * Writes and erases on a device wait for a background range erase of that device to finish.
+    * The blocking functions first complete all queued requests.
+    **/
+    RES_t flashSPAN_Submit(flashSPAN_req_t *req);
+
+    /**
+    * \brief Advance the queued requests
+    * \return 1 while requests are queued. 0 when all have completed.
+    *
+    * Starts the next request on every idle device and the next program cycle of every write
+    * whose device is ready. Reads and the callbacks of completed requests run from here.
+    **/
+    uint8_t flashSPAN_Service(void);
+
+    /**
+    * \brief Get a pointer to the request statistics
+    **/
+    const flashSPAN_asyncStats_t* flashSPAN_GetAsyncStats(void);
+
+    /**
+    * \brief Clears the request statistics except the current depth
+    **/
+    void flashSPAN_ClearAsyncStats(void);
+#endif
+
+#if FLASH_CACHE_LINES
+    /**
+    * \brief Get a pointer to the read cache statistics
+    *
+    * Only flashSPAN_Read() uses the cache. flashSPAN_ReadV() and submitted reads always read the
+    * devices.
+    **/
+    const flashSPAN_cacheStats_t* flashSPAN_GetCacheStats(void);
+
+    /**
+    * \brief Clears the read cache statistics
+    **/
+    void flashSPAN_ClearCacheStats(void);
+
+    /**
+    * \brief Drop all cached lines
+    *
+    * Only needed if the devices were written without the flashSPAN functions.
+    **/
+    void flashSPAN_FlushCache(void);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -40,7 +40,8 @@
 *            array of \ref MOD_SST25VF "SST25VF Serial Flash" devices
 * \author Alex Mykyta
 *
-* Compiling with Cygwin emulates the Spanned Flash Volume on the local filesystem. \n \n
+* Compiling for a host other than the MSP430 runs the volume on the
+* \ref MOD_SST25VF_SIM "SST25VF Serial Flash Simulator". \n \n
 *
 * This implementation of \ref MOD_FLASHSPAN "Spanned Flash Memory Volume" also requires the following
 * modules:
@@ -57,161 +58,538 @@
 **/
 
 #include <stdint.h>
+#include <string.h>
 
-#ifdef __MSP430__
 #include "SST25VF.h"
+#ifndef __MSP430__
+#include "SST25VF_sim.h"
+#endif
+
+#include "FlashSPAN.h"
+
+///\cond INTERNAL
+#if (FLASH_BLOCKSIZE == 0x1000)
+#define FLASH_ETYPE     SST_ETYPE_4K
+#elif (FLASH_BLOCKSIZE == 0x8000)
+#define FLASH_ETYPE     SST_ETYPE_32K
+#elif (FLASH_BLOCKSIZE == 0x10000)
+#define FLASH_ETYPE     SST_ETYPE_64K
 #else
-#ifdef __CYGWIN32__
-#include "SST25VF_W32TB.h"
+#error "Invalid FLASH_BLOCKSIZE"
+#endif
+
+// Block size of each erase type
+static const uint32_t ERASE_SIZE[SST_ETYPE_COUNT] = {0x1000, 0x8000, 0x10000};
+
+#if FLASH_STRIPE_SIZE && FLASH_MIRROR
+#error "FLASH_STRIPE_SIZE and FLASH_MIRROR can not be combined"
 #endif
+#if FLASH_MIRROR && (SST_CE_MODE != 0)
+#error "FLASH_MIRROR needs SST_CE_MODE 0"
 #endif
 
-#include "FlashSPAN.h"
+// Devices are concatenated
+#define FLASH_CONCAT    (!FLASH_STRIPE_SIZE && !FLASH_MIRROR)
 
-flashSPAN_t flashSPAN;
+#if FLASH_ASYNC && !FLASH_CONCAT
+#error "FLASH_ASYNC needs the concatenated layout"
+#endif
+#if FLASH_OVERWRITE && FLASH_STRIPE_SIZE
+#error "FLASH_OVERWRITE can not be combined with FLASH_STRIPE_SIZE"
+#endif
+#if FLASH_OVERWRITE && (FLASH_BLOCKSIZE > 0x8000)
+#error "FLASH_OVERWRITE needs FLASH_BLOCKSIZE of 32 KB or less"
+#endif
+
+// Size of the volume in bytes
+static uint32_t VolumeSize;
+#define VOLUME_SIZE     VolumeSize
+
+#if FLASH_STRIPE_SIZE
+#if (FLASH_STRIPE_SIZE & (FLASH_STRIPE_SIZE - 1)) || (FLASH_STRIPE_SIZE > FLASH_BLOCKSIZE)
+#error "FLASH_STRIPE_SIZE must be a power of two no larger than FLASH_BLOCKSIZE"
+#endif
+
+// Write state of each device in stripedWrite(). Offsets are into the caller's data.
+static int32_t StripeOff[FLASH_DEVICECOUNT];    // offset of the device's current stripe
+static uint32_t StripePos[FLASH_DEVICECOUNT];   // offset of the next byte to program
+static uint32_t StripeEnd[FLASH_DEVICECOUNT];   // end of the part of the stripe to program
+static uint32_t StripeAddr[FLASH_DEVICECOUNT];  // device address of the next byte
+#elif FLASH_MIRROR
+// Mask of all devices for sst25vf_SetBroadcast()
+#define MIRROR_ALL      ((uint16_t)((1UL << FLASH_DEVICECOUNT) - 1))
+#else
+// First address of each device in the volume. The last entry is the size of the volume.
+static uint32_t DevBase[FLASH_DEVICECOUNT + 1];
+
+// log2 of the device size if all devices have the same power-of-two size. Otherwise 0.
+static uint8_t DevShift;
 
 //--------------------------------------------------------------------------------------------------
-RES_t flashSPAN_Init(void)
+// Translate a volume address (< VOLUME_SIZE) into a device index and the address within it
+static uint8_t locate(uint32_t *address)
 {
-    // Check each device and fetch the DeviceBlocks. If any device is unresponsive, return a fail.
-    uint8_t i;
+    uint8_t device;
 
-    flashSPAN.BlockCount = 0;
-    for (i = 0; i < FLASH_DEVICECOUNT; i++)
+    if (DevShift)
     {
-        sst25vf_SetCurrentDevice(i);
-        switch (sst25vf_Init())
+        device = (uint8_t)(*address >> DevShift);
+    }
+    else
+    {
+        device = 0;
+        while (*address >= DevBase[device + 1])
         {
-#ifdef _SST25VF_W32TB_H_
-        case TEST_4000_ID:
-            flashSPAN.DeviceBlocks[i] = (TEST_4000_SIZE / FLASH_BLOCKSIZE);
-            flashSPAN.BlockCount += (TEST_4000_SIZE / FLASH_BLOCKSIZE);
-            break;
-        case TEST_18000_ID:
-            flashSPAN.DeviceBlocks[i] = (TEST_18000_SIZE / FLASH_BLOCKSIZE);
-            flashSPAN.BlockCount += (TEST_18000_SIZE / FLASH_BLOCKSIZE);
-            break;
+            device++;
+        }
+    }
+    *address -= DevBase[device];
+    return(device);
+}
 #endif
 
-        case MX25R1035F_ID:
-            flashSPAN.DeviceBlocks[i] = (SST25VF010_SIZE / FLASH_BLOCKSIZE);
-            flashSPAN.BlockCount += (SST25VF010_SIZE / FLASH_BLOCKSIZE);
-            break;
-        case SST25VF040_ID:
-            flashSPAN.DeviceBlocks[i] = (SST25VF040_SIZE / FLASH_BLOCKSIZE);
-            flashSPAN.BlockCount += (SST25VF040_SIZE / FLASH_BLOCKSIZE);
-            break;
-        case SST25VF080_ID:
-            flashSPAN.DeviceBlocks[i] = (SST25VF080_SIZE / FLASH_BLOCKSIZE);
-            flashSPAN.BlockCount += (SST25VF080_SIZE / FLASH_BLOCKSIZE);
-            break;
-        case SST25VF016_ID:
-            flashSPAN.DeviceBlocks[i] = (SST25VF016_SIZE / FLASH_BLOCKSIZE);
-            flashSPAN.BlockCount += (SST25VF016_SIZE / FLASH_BLOCKSIZE);
-            break;
-        case SST25VF032_ID:
-            flashSPAN.DeviceBlocks[i] = (SST25VF032_SIZE / FLASH_BLOCKSIZE);
-            flashSPAN.BlockCount += (SST25VF032_SIZE / FLASH_BLOCKSIZE);
-            break;
+// Background range erase state of each device
+static uint32_t EraseAddr[FLASH_DEVICECOUNT];       // next address to erase
+static uint32_t EraseRemaining[FLASH_DEVICECOUNT];  // bytes left to erase
+static uint8_t EraseBusy[FLASH_DEVICECOUNT];        // an erase command is executing
+static uint8_t EraseSuspended[FLASH_DEVICECOUNT];
 
-        default:
-            return(RES_FAIL);
+//--------------------------------------------------------------------------------------------------
+// Largest erase type the device supports that is aligned at addr and fits in remaining
+static int8_t nextErase(const sst25vf_info_t *info, uint32_t addr, uint32_t remaining)
+{
+    int8_t t;
+    for (t = SST_ETYPE_COUNT - 1; t > FLASH_ETYPE; t--)
+    {
+        if (info->eraseCmd[t] && (ERASE_SIZE[t] <= remaining) && ((addr & (ERASE_SIZE[t] - 1)) == 0))
+        {
+            break;
         }
     }
+    return(t);
+}
 
-    return(RES_OK);
+//--------------------------------------------------------------------------------------------------
+// Make a device with a background erase accessible. The erase is suspended if allowed and
+// supported, otherwise the current erase command is waited for.
+static void eraseHold(uint8_t device, uint8_t allowSuspend)
+{
+    if (!EraseBusy[device] || EraseSuspended[device])
+    {
+        return;
+    }
+    sst25vf_SetCurrentDevice(device);
+#if FLASH_ERASE_SUSPEND
+    if (allowSuspend && (sst25vf_GetInfo()->flags & SST_CAP_SUSPEND) && sst25vf_IsBusy())
+    {
+        sst25vf_EraseSuspend();
+        EraseSuspended[device] = 1;
+        return;
+    }
+#endif
+    sst25vf_StallBusy();
+    EraseBusy[device] = 0;
 }
+
 //--------------------------------------------------------------------------------------------------
+// Resume all erases suspended by eraseHold()
+static void eraseResume(void)
+{
+    uint8_t device;
+    for (device = 0; device < FLASH_DEVICECOUNT; device++)
+    {
+        if (EraseSuspended[device])
+        {
+            sst25vf_SetCurrentDevice(device);
+            sst25vf_EraseResume();
+            EraseSuspended[device] = 0;
+        }
+    }
+}
 
-RES_t flashSPAN_Read(uint32_t address, uint8_t *data, uint16_t nBytes)
+#if FLASH_CACHE_LINES
+//--------------------------------------------------------------------------------------------------
+// A background range erase is in progress on any device
+static uint8_t eraseActive(void)
 {
     uint8_t device;
-    uint32_t maxNbytes;
 
-    // check if start address is valid
-    if (address >= ((uint32_t)flashSPAN.BlockCount * FLASH_BLOCKSIZE))
+    for (device = 0; device < FLASH_DEVICECOUNT; device++)
     {
-        return(RES_PARAMERR); //requested data is past available address space
+        if (EraseBusy[device] || EraseRemaining[device])
+        {
+            return(1);
+        }
     }
+    return(0);
+}
+#endif
 
-    // check if access range is within the address range
-    if ((address + nBytes) > ((uint32_t)flashSPAN.BlockCount * FLASH_BLOCKSIZE))
+#if FLASH_ASYNC
+static flashSPAN_req_t *Queue[FLASH_DEVICECOUNT];   // requests waiting on each device
+static flashSPAN_req_t *Active[FLASH_DEVICECOUNT];  // request in progress on each device
+static uint32_t Head[FLASH_DEVICECOUNT];            // device address of the last request started
+static uint32_t ActiveSince[FLASH_DEVICECOUNT];
+static flashSPAN_asyncStats_t AsyncStats;
+
+//--------------------------------------------------------------------------------------------------
+// Link to the next request of a device: the lowest address at or above the head, otherwise the
+// lowest address (C-SCAN). NULL if the queue is empty.
+static flashSPAN_req_t** nextRequest(uint8_t device)
+{
+    flashSPAN_req_t **link;
+    flashSPAN_req_t **above = 0;
+    flashSPAN_req_t **lowest = 0;
+
+    for (link = &Queue[device]; *link; link = &(*link)->next)
     {
-        return(RES_PARAMERR);
+        if (((*link)->devAddr >= Head[device])
+            && ((above == 0) || ((*link)->devAddr < (*above)->devAddr)))
+        {
+            above = link;
+        }
+        if ((lowest == 0) || ((*link)->devAddr < (*lowest)->devAddr))
+        {
+            lowest = link;
+        }
     }
+    return(above ? above : lowest);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Completes the active request of a device
+static void requestDone(uint8_t device, RES_t result)
+{
+    flashSPAN_req_t *req = Active[device];
+    uint32_t now = FLASH_ASYNC_CLOCK();
+    uint32_t latency = now - req->submitTime;
 
+    Active[device] = 0;
+    AsyncStats.busyTime[device] += now - ActiveSince[device];
+    AsyncStats.depth--;
+    AsyncStats.completed[req->op]++;
+    AsyncStats.latencySum[req->op] += latency;
+    if (latency > AsyncStats.latencyMax[req->op])
+    {
+        AsyncStats.latencyMax[req->op] = latency;
+    }
 
-    // Calculate device index and local address
-    device = 0;
-    while (address >= ((uint32_t)flashSPAN.DeviceBlocks[device]*FLASH_BLOCKSIZE))
+    req->result = result;
+    if (req->callback)
     {
-        address -= ((uint32_t)flashSPAN.DeviceBlocks[device] * FLASH_BLOCKSIZE);
-        device++;
+        req->callback(req);
     }
+}
+
+//--------------------------------------------------------------------------------------------------
+// Starts a request on an idle device. Reads complete right away.
+static void requestStart(uint8_t device, flashSPAN_req_t *req)
+{
+    Active[device] = req;
+    ActiveSince[device] = FLASH_ASYNC_CLOCK();
+    Head[device] = req->devAddr;
+    req->done = 0;
+
+    switch (req->op)
+    {
+    case FLASH_OP_READ:
+        eraseHold(device, 1);
+        sst25vf_SetCurrentDevice(device);
+        sst25vf_Read(req->devAddr, req->data, req->nBytes);
+        eraseResume();
+        requestDone(device, RES_OK);
+        break;
+    case FLASH_OP_ERASE:
+        sst25vf_SetCurrentDevice(device);
+#if FLASH_ERASE_BLANK_CHECK
+        if (sst25vf_IsBlank(req->devAddr, FLASH_BLOCKSIZE))
+        {
+            requestDone(device, RES_OK);
+            break;
+        }
+#endif
+        // flashSPAN_Init() only accepts devices that have this erase
+        if (sst25vf_GetInfo()->eraseCmd[FLASH_ETYPE] == 0)
+        {
+            requestDone(device, RES_FAIL);
+            break;
+        }
+        sst25vf_xEraseStart(req->devAddr, sst25vf_GetInfo()->eraseCmd[FLASH_ETYPE]);
+        break;
+    default:
+        break; // program cycles are started by requestStep()
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+// Advances the active request of a device once the device is ready
+static void requestStep(uint8_t device)
+{
+    flashSPAN_req_t *req = Active[device];
+
+    sst25vf_SetCurrentDevice(device);
+    if (sst25vf_IsBusy())
+    {
+        return;
+    }
+    if ((req->op == FLASH_OP_WRITE) && (req->done < req->nBytes))
+    {
+        req->done += sst25vf_ProgramStart(req->devAddr + req->done, &req->data[req->done],
+                                          req->nBytes - req->done);
+        return;
+    }
+    if (req->op == FLASH_OP_WRITE)
+    {
+        sst25vf_ProgramFinish();
+    }
+    requestDone(device, RES_OK);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Completes all queued requests before a blocking function accesses the devices. Queued writes
+// and erases may be waiting for a background range erase.
+static void asyncDrain(void)
+{
+    while (flashSPAN_Service())
+    {
+        flashSPAN_EraseService();
+    }
+}
+#else
+#define asyncDrain()
+#endif
+
+#if FLASH_STRIPE_SIZE
+//--------------------------------------------------------------------------------------------------
+// Stripe k of the volume is stripe k / FLASH_DEVICECOUNT of device k % FLASH_DEVICECOUNT
+static void stripedRead(uint32_t address, uint8_t *data, uint16_t nBytes)
+{
+    uint32_t k;
+    uint32_t n;
+    uint8_t device;
 
-    // access addresses per device.
     while (nBytes > 0)
     {
-        // calculate the number of bytes that can be accessed in the current device
-        maxNbytes = ((uint32_t)flashSPAN.DeviceBlocks[device] * FLASH_BLOCKSIZE) - address;
-        if (nBytes > maxNbytes)
+        k = address / FLASH_STRIPE_SIZE;
+        n = FLASH_STRIPE_SIZE - (address % FLASH_STRIPE_SIZE);
+        if (n > nBytes)
         {
-            // overflows to the next device
-            sst25vf_SetCurrentDevice(device);
-            sst25vf_Read(address, data, maxNbytes);
-            nBytes -= maxNbytes; // decrement the number of bytes accessed
-            data += maxNbytes; // increment the data pointer
-            address = 0;
-            device++;
+            n = nBytes;
+        }
+        device = k % FLASH_DEVICECOUNT;
+        eraseHold(device, 1);
+        sst25vf_SetCurrentDevice(device);
+        sst25vf_ReadStart((k / FLASH_DEVICECOUNT) * FLASH_STRIPE_SIZE + (address % FLASH_STRIPE_SIZE),
+                            data, n);
+        address += n;
+        data += n;
+        nBytes -= n;
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+// Programs all devices at the same time. Each ready device gets its next program cycle while the
+// others are busy.
+static void stripedWrite(uint32_t address, const uint8_t *data, uint16_t nBytes)
+{
+    uint32_t k;
+    uint8_t device;
+    uint8_t active;
+
+    // Find the first stripe of each device within the range
+    for (device = 0; device < FLASH_DEVICECOUNT; device++)
+    {
+        k = address / FLASH_STRIPE_SIZE;
+        k += (device + FLASH_DEVICECOUNT - (k % FLASH_DEVICECOUNT)) % FLASH_DEVICECOUNT;
+        StripeOff[device] = (int32_t)((k * FLASH_STRIPE_SIZE) - address);
+        StripeAddr[device] = (k / FLASH_DEVICECOUNT) * FLASH_STRIPE_SIZE;
+        if (StripeOff[device] < 0)
+        {
+            StripePos[device] = 0;
+            StripeAddr[device] -= StripeOff[device];
         }
         else
         {
-            // finish up read
+            StripePos[device] = StripeOff[device];
+        }
+        StripeEnd[device] = StripeOff[device] + FLASH_STRIPE_SIZE;
+        if (StripeEnd[device] > nBytes)
+        {
+            StripeEnd[device] = nBytes;
+        }
+        if (StripePos[device] < StripeEnd[device])
+        {
+            eraseHold(device, 0);
+        }
+    }
+
+    do
+    {
+        active = 0;
+        for (device = 0; device < FLASH_DEVICECOUNT; device++)
+        {
+            if (StripePos[device] >= StripeEnd[device])
+            {
+                continue;
+            }
+            active = 1;
             sst25vf_SetCurrentDevice(device);
-            sst25vf_Read(address, data, nBytes);
+            if (sst25vf_IsBusy())
+            {
+                continue;
+            }
+
+            k = sst25vf_ProgramStart(StripeAddr[device], &data[StripePos[device]],
+                                     StripeEnd[device] - StripePos[device]);
+            StripePos[device] += k;
+            StripeAddr[device] += k;
+
+            // The device's next stripe continues at the next device address
+            if (StripePos[device] == StripeEnd[device])
+            {
+                StripeOff[device] += (uint32_t)FLASH_STRIPE_SIZE * FLASH_DEVICECOUNT;
+                if (StripeOff[device] < nBytes)
+                {
+                    StripePos[device] = StripeOff[device];
+                    StripeEnd[device] = StripeOff[device] + FLASH_STRIPE_SIZE;
+                    if (StripeEnd[device] > nBytes)
+                    {
+                        StripeEnd[device] = nBytes;
+                    }
+                }
+            }
+        }
+    } while (active);
+
+    for (device = 0; device < FLASH_DEVICECOUNT; device++)
+    {
+        sst25vf_SetCurrentDevice(device);
+        sst25vf_ProgramFinish();
+    }
+}
+
+#elif FLASH_MIRROR
+//--------------------------------------------------------------------------------------------------
+// Selects a mirror that is not busy for a read. If all of them are, the first one once its erase
+// has been suspended or has finished.
+static void selectMirror(void)
+{
+    uint8_t device;
+
+    for (device = 0; device < FLASH_DEVICECOUNT; device++)
+    {
+        sst25vf_SetCurrentDevice(device);
+        if (!sst25vf_IsBusy())
+        {
             break;
         }
     }
-    return(RES_OK);
+    if (device == FLASH_DEVICECOUNT)
+    {
+        device = 0;
+    }
+    eraseHold(device, 1);
+    sst25vf_SetCurrentDevice(device);
 }
 
 //--------------------------------------------------------------------------------------------------
-RES_t flashSPAN_Write(uint32_t address, uint8_t *data, uint16_t nBytes)
+// Selects all mirrors for a write, so that one command stream programs them
+static void selectAllMirrors(void)
 {
     uint8_t device;
-    uint32_t maxNbytes;
 
-    // check if start address is valid
-    if (address >= ((uint32_t)flashSPAN.BlockCount * FLASH_BLOCKSIZE))
+    for (device = 0; device < FLASH_DEVICECOUNT; device++)
     {
-        return(RES_PARAMERR); //sector is past available address space
+        eraseHold(device, 0);
     }
+    sst25vf_SetBroadcast(MIRROR_ALL);
+}
+#endif
 
-    // check if access range is within the address range
-    if ((address + nBytes) > ((uint32_t)flashSPAN.BlockCount * FLASH_BLOCKSIZE))
+//--------------------------------------------------------------------------------------------------
+// Total length of a vector, or 0xFFFFFFFF if it does not fit in the volume at address
+static uint32_t vectorLength(uint32_t address, const flashSPAN_iovec_t *iov, uint8_t iovCount)
+{
+    uint32_t total = 0;
+
+    while (iovCount--)
     {
-        return(RES_PARAMERR);
+        total += iov->nBytes;
+        iov++;
+    }
+    if ((address >= VOLUME_SIZE) || (total > (VOLUME_SIZE - address)))
+    {
+        return(0xFFFFFFFFUL);
     }
+    return(total);
+}
 
+#if !FLASH_STRIPE_SIZE
+//--------------------------------------------------------------------------------------------------
+// Passes the next nBytes of a vector to sst25vf_ReadCont() or sst25vf_WriteCont(). The cursor
+// (*iov, *offset) is advanced past them.
+static void vectorCont(uint8_t write, const flashSPAN_iovec_t **iov, uint16_t *offset, uint32_t nBytes)
+{
+    uint16_t n;
 
-    // Calculate device index and local address
-    device = 0;
-    while (address >= ((uint32_t)flashSPAN.DeviceBlocks[device]*FLASH_BLOCKSIZE))
+    while (nBytes > 0)
     {
-        address -= ((uint32_t)flashSPAN.DeviceBlocks[device] * FLASH_BLOCKSIZE);
-        device++;
+        n = (*iov)->nBytes - *offset;
+        if (n > nBytes)
+        {
+            n = nBytes;
+        }
+        if (write)
+        {
+            sst25vf_WriteCont(&(*iov)->data[*offset], n);
+        }
+        else
+        {
+            sst25vf_ReadCont(&(*iov)->data[*offset], n);
+        }
+        nBytes -= n;
+        *offset += n;
+        if (*offset == (*iov)->nBytes)
+        {
+            (*iov)++;
+            *offset = 0;
+        }
     }
+}
+#endif
+///\endcond
+
+flashSPAN_t flashSPAN;
+
+//--------------------------------------------------------------------------------------------------
+// Reads a checked range of the volume from the devices
+static void volumeRead(uint32_t address, uint8_t *data, uint16_t nBytes)
+{
+#if FLASH_CONCAT
+    uint8_t device;
+    uint32_t maxNbytes;
+#endif
+
+#if FLASH_STRIPE_SIZE
+    stripedRead(address, data, nBytes);
+#elif FLASH_MIRROR
+    selectMirror();
+    sst25vf_ReadStart(address, data, nBytes);
+#else
+    // Calculate device index and local address
+    device = locate(&address);
 
     // access addresses per device.
     while (nBytes > 0)
     {
         // calculate the number of bytes that can be accessed in the current device
-        maxNbytes = ((uint32_t)flashSPAN.DeviceBlocks[device] * FLASH_BLOCKSIZE) - address;
+        maxNbytes = (DevBase[device + 1] - DevBase[device]) - address;
         if (nBytes > maxNbytes)
         {
             // overflows to the next device
+            eraseHold(device, 1);
             sst25vf_SetCurrentDevice(device);
-            sst25vf_Write(address, data, maxNbytes);
+            sst25vf_ReadStart(address, data, maxNbytes);
             nBytes -= maxNbytes; // decrement the number of bytes accessed
             data += maxNbytes; // increment the data pointer
             address = 0;
@@ -219,59 +597,972 @@ RES_t flashSPAN_Write(uint32_t address, uint8_t *data, uint16_t nBytes)
         }
         else
         {
-            // finish up write
+            // finish up read
+            eraseHold(device, 1);
             sst25vf_SetCurrentDevice(device);
-            sst25vf_Write(address, data, nBytes);
+            sst25vf_ReadStart(address, data, nBytes);
             break;
         }
     }
-    return(RES_OK);
+#endif
+
+    // Devices on separate buses were read concurrently. Wait for all of them.
+    sst25vf_Sync();
+    eraseResume();
 }
 
-//--------------------------------------------------------------------------------------------------
-RES_t flashSPAN_EraseBlock(uint16_t block)
-{
-    uint8_t device;
+#if FLASH_CACHE_LINES
+#if (FLASH_CACHE_LINE_SIZE & (FLASH_CACHE_LINE_SIZE - 1)) || (FLASH_CACHE_LINE_SIZE > FLASH_BLOCKSIZE)
+#error "FLASH_CACHE_LINE_SIZE must be a power of 2 no larger than FLASH_BLOCKSIZE"
+#endif
+#if FLASH_CACHE_USBRAM && ((FLASH_CACHE_LINES * FLASH_CACHE_LINE_SIZE) > 0x800)
+#error "The cache lines do not fit in the USB RAM"
+#endif
 
-    // check if block is valid
-    if (block >= (flashSPAN.BlockCount))
-    {
-        return(RES_PARAMERR); //sector is past available address space
-    }
+#define LINE_NONE       0xFFFFFFFFUL
+#define LINE_MASK       ((uint32_t)FLASH_CACHE_LINE_SIZE - 1)
 
-    // Calculate device index and local block
-    device = 0;
-    while (block >= (flashSPAN.DeviceBlocks[device]))
-    {
-        block = block - flashSPAN.DeviceBlocks[device];
-        device++;
-    }
+// Larger reads bypass the cache so that they do not push out the hot lines
+#define CACHE_MAX_READ  ((FLASH_CACHE_LINES * FLASH_CACHE_LINE_SIZE) / 4)
 
-    // perform block erase
-    sst25vf_SetCurrentDevice(device);
-#if (FLASH_BLOCKSIZE == 0x1000)
-    sst25vf_4kErase(block * FLASH_BLOCKSIZE);
-#elif (FLASH_BLOCKSIZE == 0xC800)
-    sst25vf_32kErase(block * FLASH_BLOCKSIZE);
+#if FLASH_CACHE_USBRAM && defined(__MSP430__)
+#pragma DATA_SECTION(CacheData, ".usbram")
+#endif
+static uint8_t CacheData[FLASH_CACHE_LINES][FLASH_CACHE_LINE_SIZE];
+static uint32_t CacheTag[FLASH_CACHE_LINES];    // volume address of each line, LINE_NONE if empty
+#if FLASH_CACHE_LRU
+static uint32_t CacheUsed[FLASH_CACHE_LINES];   // CacheTime of the last access of each line
+static uint32_t CacheTime;
 #else
-#error "Invalid FLASH_BLOCKSIZE"
+static uint8_t CacheRef[FLASH_CACHE_LINES];     // line was used since the hand last passed it
+static uint16_t CacheHand;
 #endif
-    return(RES_OK);
-}
+static flashSPAN_cacheStats_t CacheStats;
 
 //--------------------------------------------------------------------------------------------------
-RES_t flashSPAN_EraseAll(void)
+// Picks the line to replace
+static uint16_t cacheVictim(void)
 {
-    uint8_t device;
+    uint16_t i;
+#if FLASH_CACHE_LRU
+    uint16_t oldest = 0;
 
-    for (device = 0; device < FLASH_DEVICECOUNT; device++)
+    for (i = 0; i < FLASH_CACHE_LINES; i++)
     {
+        if (CacheTag[i] == LINE_NONE)
+        {
+            return(i);
+        }
+        if (CacheUsed[i] < CacheUsed[oldest])
+        {
+            oldest = i;
+        }
+    }
+    return(oldest);
+#else
+    // Advance the hand past lines used since its last pass, clearing their reference bits
+    while ((CacheTag[CacheHand] != LINE_NONE) && CacheRef[CacheHand])
+    {
+        CacheRef[CacheHand] = 0;
+        CacheHand = (CacheHand + 1) % FLASH_CACHE_LINES;
+    }
+    i = CacheHand;
+    CacheHand = (CacheHand + 1) % FLASH_CACHE_LINES;
+    return(i);
+#endif
+}
+
+//--------------------------------------------------------------------------------------------------
+// Reads a checked range of the volume through the cache
+static void cacheRead(uint32_t address, uint8_t *data, uint16_t nBytes)
+{
+    uint32_t line;
+    uint16_t offset;
+    uint16_t n;
+    uint16_t i;
+
+    if (nBytes > CACHE_MAX_READ)
+    {
+        CacheStats.bypassed++;
+        volumeRead(address, data, nBytes);
+        return;
+    }
+
+    while (nBytes > 0)
+    {
+        line = address & ~LINE_MASK;
+        offset = (uint16_t)(address & LINE_MASK);
+        n = FLASH_CACHE_LINE_SIZE - offset;
+        if (n > nBytes)
+        {
+            n = nBytes;
+        }
+
+        for (i = 0; i < FLASH_CACHE_LINES; i++)
+        {
+            if (CacheTag[i] == line)
+            {
+                break;
+            }
+        }
+
+        if (i < FLASH_CACHE_LINES)
+        {
+            CacheStats.hits++;
+        }
+        else if (eraseActive())
+        {
+            // A background range erase could still change the line. Read around the cache.
+            CacheStats.bypassed++;
+            volumeRead(address, data, n);
+            i = FLASH_CACHE_LINES;
+        }
+        else
+        {
+            CacheStats.misses++;
+            i = cacheVictim();
+            volumeRead(line, CacheData[i], FLASH_CACHE_LINE_SIZE);
+            CacheTag[i] = line;
+        }
+
+        if (i < FLASH_CACHE_LINES)
+        {
+#if FLASH_CACHE_LRU
+            CacheUsed[i] = ++CacheTime;
+#else
+            CacheRef[i] = 1;
+#endif
+            memcpy(data, &CacheData[i][offset], n);
+        }
+        data += n;
+        address += n;
+        nBytes -= n;
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+// Drops the lines that overlap a range of the volume
+static void cacheInvalidate(uint32_t address, uint32_t length)
+{
+    uint16_t i;
+    uint32_t first = address & ~LINE_MASK;
+
+    for (i = 0; i < FLASH_CACHE_LINES; i++)
+    {
+        if ((CacheTag[i] != LINE_NONE) && (CacheTag[i] >= first)
+            && ((CacheTag[i] - first) < ((address - first) + length)))
+        {
+            CacheTag[i] = LINE_NONE;
+            CacheStats.invalidated++;
+        }
+    }
+}
+#else
+#define cacheInvalidate(address, length)
+#endif
+
+//--------------------------------------------------------------------------------------------------
+RES_t flashSPAN_Init(void)
+{
+    // Check each device and fetch the DeviceBlocks. If any device is unresponsive, return a fail.
+    uint8_t i;
+#if FLASH_CONCAT
+    uint32_t size;
+#endif
+#if FLASH_MIRROR
+    uint32_t jedec = 0;
+#endif
+    const sst25vf_info_t *info;
+
+    flashSPAN.BlockCount = 0;
+#if FLASH_CONCAT
+    DevBase[0] = 0;
+#endif
+#if FLASH_ASYNC
+    memset(Queue, 0, sizeof(Queue));
+    memset(Active, 0, sizeof(Active));
+    memset(Head, 0, sizeof(Head));
+    memset(&AsyncStats, 0, sizeof(AsyncStats));
+#endif
+#if FLASH_CACHE_LINES
+    flashSPAN_FlushCache();
+#endif
+    for (i = 0; i < FLASH_DEVICECOUNT; i++)
+    {
+        sst25vf_SetCurrentDevice(i);
+        if (sst25vf_Init() == SST_INVALID_ID)
+        {
+            return(RES_FAIL);
+        }
+        info = sst25vf_GetInfo();
+        // Devices known from SFDP alone may lack an erase of FLASH_BLOCKSIZE. Every block erase
+        // of the volume relies on it.
+        if (info->eraseCmd[FLASH_ETYPE] == 0)
+        {
+            return(RES_FAIL);
+        }
+        flashSPAN.DeviceBlocks[i] = (info->size / FLASH_BLOCKSIZE);
+#if FLASH_MIRROR
+        // Mirrors receive the same command stream, so they must be the same part
+        if (i == 0)
+        {
+            jedec = sst25vf_JEDECID();
+        }
+        else if (sst25vf_JEDECID() != jedec)
+        {
+            return(RES_FAIL);
+        }
+#endif
+#if !FLASH_CONCAT
+        // A volume block is the same block of every device. The smallest device sets the size.
+        if ((i == 0) || (flashSPAN.DeviceBlocks[i] < flashSPAN.BlockCount))
+        {
+            flashSPAN.BlockCount = flashSPAN.DeviceBlocks[i];
+        }
+    }
+    VolumeSize = flashSPAN.BlockCount * FLASH_VOLUME_BLOCKSIZE;
+#if FLASH_MIRROR
+    if (sst25vf_SetBroadcast(MIRROR_ALL) != RES_OK)
+    {
+        return(RES_FAIL);
+    }
+    sst25vf_SetCurrentDevice(0);
+#endif
+#else
+        flashSPAN.BlockCount += (info->size / FLASH_BLOCKSIZE);
+        DevBase[i + 1] = DevBase[i] + (flashSPAN.DeviceBlocks[i] * FLASH_BLOCKSIZE);
+    }
+    VolumeSize = DevBase[FLASH_DEVICECOUNT];
+
+    // Devices of equal power-of-two size are located with a shift
+    size = DevBase[1];
+    DevShift = 0;
+    for (i = 1; i < FLASH_DEVICECOUNT; i++)
+    {
+        if ((DevBase[i + 1] - DevBase[i]) != size)
+        {
+            size = 0;
+        }
+    }
+    if (size && !(size & (size - 1)))
+    {
+        while ((1UL << DevShift) < size)
+        {
+            DevShift++;
+        }
+    }
+#endif
+
+    return(RES_OK);
+}
+//--------------------------------------------------------------------------------------------------
+
+RES_t flashSPAN_Read(uint32_t address, uint8_t *data, uint16_t nBytes)
+{
+    asyncDrain();
+
+    // check if start address is valid
+    if (address >= VOLUME_SIZE)
+    {
+        return(RES_PARAMERR); //requested data is past available address space
+    }
+
+    // check if access range is within the address range
+    if (nBytes > (VOLUME_SIZE - address))
+    {
+        return(RES_PARAMERR);
+    }
+
+#if FLASH_CACHE_LINES
+    cacheRead(address, data, nBytes);
+#else
+    volumeRead(address, data, nBytes);
+#endif
+    return(RES_OK);
+}
+
+//--------------------------------------------------------------------------------------------------
+RES_t flashSPAN_Write(uint32_t address, uint8_t *data, uint16_t nBytes)
+{
+#if FLASH_CONCAT
+    uint8_t device;
+    uint32_t maxNbytes;
+#endif
+
+    asyncDrain();
+
+    // check if start address is valid
+    if (address >= VOLUME_SIZE)
+    {
+        return(RES_PARAMERR); //sector is past available address space
+    }
+
+    // check if access range is within the address range
+    if (nBytes > (VOLUME_SIZE - address))
+    {
+        return(RES_PARAMERR);
+    }
+
+    cacheInvalidate(address, nBytes);
+
+#if FLASH_STRIPE_SIZE
+    stripedWrite(address, data, nBytes);
+#elif FLASH_MIRROR
+    selectAllMirrors();
+    sst25vf_Write(address, data, nBytes);
+    sst25vf_SetCurrentDevice(0);
+#else
+    // Calculate device index and local address
+    device = locate(&address);
+
+    // access addresses per device.
+    while (nBytes > 0)
+    {
+        // calculate the number of bytes that can be accessed in the current device
+        maxNbytes = (DevBase[device + 1] - DevBase[device]) - address;
+        if (nBytes > maxNbytes)
+        {
+            // overflows to the next device
+            eraseHold(device, 0);
+            sst25vf_SetCurrentDevice(device);
+            sst25vf_Write(address, data, maxNbytes);
+            nBytes -= maxNbytes; // decrement the number of bytes accessed
+            data += maxNbytes; // increment the data pointer
+            address = 0;
+            device++;
+        }
+        else
+        {
+            // finish up write
+            eraseHold(device, 0);
+            sst25vf_SetCurrentDevice(device);
+            sst25vf_Write(address, data, nBytes);
+            break;
+        }
+    }
+#endif
+    return(RES_OK);
+}
+
+//--------------------------------------------------------------------------------------------------
+RES_t flashSPAN_ReadV(uint32_t address, const flashSPAN_iovec_t *iov, uint8_t iovCount)
+{
+    uint32_t total;
+#if FLASH_CONCAT
+    uint8_t device;
+    uint32_t n;
+    uint16_t offset = 0;
+#elif !FLASH_STRIPE_SIZE
+    uint16_t offset = 0;
+#endif
+
+    asyncDrain();
+    total = vectorLength(address, iov, iovCount);
+    if (total == 0xFFFFFFFFUL)
+    {
+        return(RES_PARAMERR);
+    }
+
+#if FLASH_STRIPE_SIZE
+    // Stripes split the transfer into pieces of their own, so segments are read one by one
+    while (iovCount--)
+    {
+        stripedRead(address, iov->data, iov->nBytes);
+        address += iov->nBytes;
+        iov++;
+    }
+    sst25vf_Sync();
+#elif FLASH_MIRROR
+    if (total > 0)
+    {
+        selectMirror();
+        sst25vf_ReadBegin(address);
+        vectorCont(0, &iov, &offset, total);
+        sst25vf_ReadEnd();
+    }
+#else
+    // One read command per device
+    while (total > 0)
+    {
+        device = locate(&address);
+        n = (DevBase[device + 1] - DevBase[device]) - address;
+        if (n > total)
+        {
+            n = total;
+        }
+        eraseHold(device, 1);
+        sst25vf_SetCurrentDevice(device);
+        sst25vf_ReadBegin(address);
+        vectorCont(0, &iov, &offset, n);
+        sst25vf_ReadEnd();
+        address = DevBase[device + 1];
+        total -= n;
+    }
+#endif
+
+    eraseResume();
+    return(RES_OK);
+}
+
+//--------------------------------------------------------------------------------------------------
+RES_t flashSPAN_WriteV(uint32_t address, const flashSPAN_iovec_t *iov, uint8_t iovCount)
+{
+    uint32_t total;
+#if FLASH_CONCAT
+    uint8_t device;
+    uint32_t n;
+    uint16_t offset = 0;
+#elif !FLASH_STRIPE_SIZE
+    uint16_t offset = 0;
+#endif
+
+    asyncDrain();
+    total = vectorLength(address, iov, iovCount);
+    if (total == 0xFFFFFFFFUL)
+    {
+        return(RES_PARAMERR);
+    }
+    cacheInvalidate(address, total);
+
+#if FLASH_STRIPE_SIZE
+    // Stripes split the transfer into pieces of their own, so segments are written one by one
+    while (iovCount--)
+    {
+        stripedWrite(address, iov->data, iov->nBytes);
+        address += iov->nBytes;
+        iov++;
+    }
+#elif FLASH_MIRROR
+    if (total > 0)
+    {
+        selectAllMirrors();
+        sst25vf_WriteBegin(address);
+        vectorCont(1, &iov, &offset, total);
+        sst25vf_WriteEnd();
+        sst25vf_SetCurrentDevice(0);
+    }
+#else
+    // One write stream per device
+    while (total > 0)
+    {
+        device = locate(&address);
+        n = (DevBase[device + 1] - DevBase[device]) - address;
+        if (n > total)
+        {
+            n = total;
+        }
+        eraseHold(device, 0);
         sst25vf_SetCurrentDevice(device);
-        sst25vf_ChipErase();
+        sst25vf_WriteBegin(address);
+        vectorCont(1, &iov, &offset, n);
+        sst25vf_WriteEnd();
+        address = DevBase[device + 1];
+        total -= n;
     }
+#endif
+
     return(RES_OK);
 }
 
+//--------------------------------------------------------------------------------------------------
+RES_t flashSPAN_EraseBlock(uint32_t block)
+{
+    uint8_t device;
+    uint32_t address;
+#if FLASH_MIRROR
+    uint16_t dirty;
+    RES_t res;
+#endif
+
+    asyncDrain();
+
+    // check if block is valid
+    if (block >= (flashSPAN.BlockCount))
+    {
+        return(RES_PARAMERR); //sector is past available address space
+    }
+    cacheInvalidate(block * FLASH_VOLUME_BLOCKSIZE, FLASH_VOLUME_BLOCKSIZE);
+
+#if FLASH_STRIPE_SIZE
+    // Erase the block on all devices at the same time
+    address = block * FLASH_BLOCKSIZE;
+    for (device = 0; device < FLASH_DEVICECOUNT; device++)
+    {
+        eraseHold(device, 0);
+        sst25vf_SetCurrentDevice(device);
+#if FLASH_ERASE_BLANK_CHECK
+        if (sst25vf_IsBlank(address, FLASH_BLOCKSIZE))
+        {
+            continue;
+        }
+#endif
+        sst25vf_xEraseStart(address, sst25vf_GetInfo()->eraseCmd[FLASH_ETYPE]);
+    }
+    for (device = 0; device < FLASH_DEVICECOUNT; device++)
+    {
+        sst25vf_SetCurrentDevice(device);
+        sst25vf_StallBusy();
+    }
+    return(RES_OK);
+#elif FLASH_MIRROR
+    // One erase command for all mirrors that are not blank
+    address = block * FLASH_BLOCKSIZE;
+    dirty = 0;
+    for (device = 0; device < FLASH_DEVICECOUNT; device++)
+    {
+        eraseHold(device, 0);
+#if FLASH_ERASE_BLANK_CHECK
+        sst25vf_SetCurrentDevice(device);
+        if (sst25vf_IsBlank(address, FLASH_BLOCKSIZE))
+        {
+            continue;
+        }
+#endif
+        dirty |= (uint16_t)1 << device;
+    }
+    if (dirty == 0)
+    {
+        return(RES_OK);
+    }
+    sst25vf_SetBroadcast(dirty);
+    res = sst25vf_EraseBlock(address, FLASH_BLOCKSIZE);
+    sst25vf_SetCurrentDevice(0);
+    return(res);
+#else
+    // Calculate device index and local address
+    address = block * FLASH_BLOCKSIZE;
+    device = locate(&address);
+
+    // perform block erase with the device's opcode for this block size
+    eraseHold(device, 0);
+    sst25vf_SetCurrentDevice(device);
+#if FLASH_ERASE_BLANK_CHECK
+    return(sst25vf_EraseBlockIfDirty(address, FLASH_BLOCKSIZE));
+#else
+    return(sst25vf_EraseBlock(address, FLASH_BLOCKSIZE));
+#endif
+#endif
+}
+
+//--------------------------------------------------------------------------------------------------
+RES_t flashSPAN_EraseRange(uint32_t start, uint32_t length)
+{
+    RES_t res;
+
+    res = flashSPAN_EraseRangeStart(start, length);
+    if (res != RES_OK)
+    {
+        return(res);
+    }
+    while (flashSPAN_EraseService());
+    return(RES_OK);
+}
+
+//--------------------------------------------------------------------------------------------------
+RES_t flashSPAN_EraseRangeStart(uint32_t start, uint32_t length)
+{
+    uint8_t device;
+    int8_t t;
+    uint32_t n;
+    uint32_t addr;
+    uint32_t devMs;
+    const sst25vf_info_t *info;
+
+    asyncDrain();
+
+    // check alignment and range
+    if ((start % FLASH_VOLUME_BLOCKSIZE) || (length % FLASH_VOLUME_BLOCKSIZE))
+    {
+        return(RES_PARAMERR);
+    }
+    if ((start > VOLUME_SIZE) || (length > (VOLUME_SIZE - start)))
+    {
+        return(RES_PARAMERR);
+    }
+    if (flashSPAN_EraseService())
+    {
+        return(RES_BUSY);
+    }
+    cacheInvalidate(start, length);
+
+    // Split the range into one part per device and estimate the time each device takes
+    flashSPAN.LastEraseMs = 0;
+    flashSPAN.LastEraseSavedMs = 0;
+    for (device = 0; device < FLASH_DEVICECOUNT; device++)
+    {
+#if FLASH_STRIPE_SIZE
+        // Volume blocks are the same blocks of every device
+        n = length / FLASH_DEVICECOUNT;
+        EraseAddr[device] = start / FLASH_DEVICECOUNT;
+        EraseRemaining[device] = n;
+        if (n == 0)
+        {
+            continue;
+        }
+#elif FLASH_MIRROR
+        // Every mirror erases the whole range. Each one is serviced and suspended on its own.
+        n = length;
+        EraseAddr[device] = start;
+        EraseRemaining[device] = n;
+        if (n == 0)
+        {
+            continue;
+        }
+#else
+        n = DevBase[device + 1] - DevBase[device];
+        EraseAddr[device] = 0;
+        EraseRemaining[device] = 0;
+        if (start >= n)
+        {
+            start -= n;
+            continue;
+        }
+        n -= start;
+        if (n > length)
+        {
+            n = length;
+        }
+        EraseAddr[device] = start;
+        EraseRemaining[device] = n;
+        length -= n;
+        start = 0;
+#endif
+
+        sst25vf_SetCurrentDevice(device);
+        info = sst25vf_GetInfo();
+        flashSPAN.LastEraseSavedMs += (n / FLASH_BLOCKSIZE) * info->eraseTimeMs[FLASH_ETYPE];
+        addr = EraseAddr[device];
+        devMs = 0;
+        while (n > 0)
+        {
+            t = nextErase(info, addr, n);
+            devMs += info->eraseTimeMs[t];
+            addr += ERASE_SIZE[t];
+            n -= ERASE_SIZE[t];
+        }
+
+        // The devices run in parallel, so the slowest one determines the duration
+        if (devMs > flashSPAN.LastEraseMs)
+        {
+            flashSPAN.LastEraseMs = devMs;
+        }
+    }
+
+    if (flashSPAN.LastEraseSavedMs > flashSPAN.LastEraseMs)
+    {
+        flashSPAN.LastEraseSavedMs -= flashSPAN.LastEraseMs;
+    }
+    else
+    {
+        flashSPAN.LastEraseSavedMs = 0;
+    }
+
+    flashSPAN_EraseService(); // start the first erase on every device
+    return(RES_OK);
+}
+
+//--------------------------------------------------------------------------------------------------
+uint8_t flashSPAN_EraseService(void)
+{
+    uint8_t device;
+    uint8_t active;
+    int8_t t;
+    const sst25vf_info_t *info;
+
+    active = 0;
+    for (device = 0; device < FLASH_DEVICECOUNT; device++)
+    {
+        if (!EraseBusy[device] && !EraseRemaining[device])
+        {
+            continue;
+        }
+
+        sst25vf_SetCurrentDevice(device);
+        if (EraseBusy[device] && sst25vf_IsBusy())
+        {
+            active = 1;
+            continue;
+        }
+        EraseBusy[device] = 0;
+
+        // Each device gets its next erase as soon as it is ready
+        if (EraseRemaining[device])
+        {
+            info = sst25vf_GetInfo();
+            t = nextErase(info, EraseAddr[device], EraseRemaining[device]);
+            sst25vf_xEraseStart(EraseAddr[device], info->eraseCmd[t]);
+            EraseAddr[device] += ERASE_SIZE[t];
+            EraseRemaining[device] -= ERASE_SIZE[t];
+            EraseBusy[device] = 1;
+            active = 1;
+        }
+    }
+    return(active);
+}
+
+//--------------------------------------------------------------------------------------------------
+RES_t flashSPAN_EraseAll(void)
+{
+    uint8_t device;
+    uint8_t active;
+
+    // Finish queued requests and a background range erase first
+    asyncDrain();
+    while (flashSPAN_EraseService());
+#if FLASH_CACHE_LINES
+    flashSPAN_FlushCache();
+#endif
+
+    // Start all chip erases, then wait for every device
+#if FLASH_MIRROR
+    sst25vf_SetBroadcast(MIRROR_ALL);
+    sst25vf_ChipEraseStart();
+#else
+    for (device = 0; device < FLASH_DEVICECOUNT; device++)
+    {
+        sst25vf_SetCurrentDevice(device);
+        sst25vf_ChipEraseStart();
+    }
+#endif
+
+    do
+    {
+        active = 0;
+        for (device = 0; device < FLASH_DEVICECOUNT; device++)
+        {
+            sst25vf_SetCurrentDevice(device);
+            active |= sst25vf_IsBusy();
+        }
+    } while (active);
+
+    return(RES_OK);
+}
+
+#if FLASH_ASYNC
+//--------------------------------------------------------------------------------------------------
+RES_t flashSPAN_Submit(flashSPAN_req_t *req)
+{
+    uint8_t device;
+    flashSPAN_req_t **link;
+    uint32_t address = req->address;
+    uint32_t length = (req->op == FLASH_OP_ERASE) ? FLASH_BLOCKSIZE : req->nBytes;
+
+    if ((req->op >= FLASH_OP_COUNT) || (length == 0) || (address >= VOLUME_SIZE))
+    {
+        return(RES_PARAMERR);
+    }
+    if ((req->op == FLASH_OP_ERASE) && (address % FLASH_BLOCKSIZE))
+    {
+        return(RES_PARAMERR);
+    }
+
+    // Requests are served by a single device
+    device = locate(&address);
+    if (length > ((DevBase[device + 1] - DevBase[device]) - address))
+    {
+        return(RES_PARAMERR);
+    }
+
+    if (req->op != FLASH_OP_READ)
+    {
+        cacheInvalidate(req->address, length);
+    }
+
+    req->devAddr = address;
+    req->result = RES_BUSY;
+    req->submitTime = FLASH_ASYNC_CLOCK();
+    req->next = 0;
+    for (link = &Queue[device]; *link; link = &(*link)->next);
+    *link = req;
+
+    AsyncStats.depth++;
+    if (AsyncStats.depth > AsyncStats.maxDepth)
+    {
+        AsyncStats.maxDepth = AsyncStats.depth;
+    }
+    return(RES_OK);
+}
+
+//--------------------------------------------------------------------------------------------------
+uint8_t flashSPAN_Service(void)
+{
+    uint8_t device;
+    flashSPAN_req_t **link;
+    flashSPAN_req_t *req;
+
+    for (device = 0; device < FLASH_DEVICECOUNT; device++)
+    {
+        if (Active[device])
+        {
+            requestStep(device);
+        }
+        if (Active[device] || (Queue[device] == 0))
+        {
+            continue;
+        }
+
+        link = nextRequest(device);
+        req = *link;
+
+        // Only reads may interrupt a background range erase of the device
+        if ((req->op != FLASH_OP_READ) && (EraseBusy[device] || EraseRemaining[device]))
+        {
+            continue;
+        }
+
+        *link = req->next;
+        requestStart(device, req);
+    }
+    return(AsyncStats.depth ? 1 : 0);
+}
+
+//--------------------------------------------------------------------------------------------------
+const flashSPAN_asyncStats_t* flashSPAN_GetAsyncStats(void)
+{
+    return(&AsyncStats);
+}
+
+//--------------------------------------------------------------------------------------------------
+void flashSPAN_ClearAsyncStats(void)
+{
+    uint8_t depth = AsyncStats.depth;
+    uint8_t device;
+
+    memset(&AsyncStats, 0, sizeof(AsyncStats));
+    AsyncStats.depth = depth;
+    AsyncStats.maxDepth = depth;
+    AsyncStats.startTime = FLASH_ASYNC_CLOCK();
+    for (device = 0; device < FLASH_DEVICECOUNT; device++)
+    {
+        if (Active[device])
+        {
+            ActiveSince[device] = AsyncStats.startTime;
+        }
+    }
+}
+#endif
+
+#if FLASH_OVERWRITE
+static uint8_t BlockBuf[FLASH_BLOCKSIZE];    // shared by all read-modify-writes
+static flashSPAN_overwriteStats_t OverwriteStats;
+
+//--------------------------------------------------------------------------------------------------
+RES_t flashSPAN_Overwrite(uint32_t address, uint8_t *data, uint16_t nBytes)
+{
+    uint16_t offset;
+    uint16_t n;
+    uint16_t i;
+    uint16_t first;
+    uint16_t last;
+    uint8_t erase;
+    RES_t res;
+
+    asyncDrain();
+
+    if ((address >= VOLUME_SIZE) || (nBytes > (VOLUME_SIZE - address)))
+    {
+        return(RES_PARAMERR);
+    }
+
+    while (nBytes > 0)
+    {
+        // Part of the data within the current block
+        offset = (uint16_t)(address % FLASH_BLOCKSIZE);
+        n = FLASH_BLOCKSIZE - offset;
+        if (n > nBytes)
+        {
+            n = nBytes;
+        }
+
+        // Find the bytes that differ and whether any bit has to go from 0 to 1
+        volumeRead(address, BlockBuf, n);
+        first = n;
+        last = 0;
+        erase = 0;
+        for (i = 0; i < n; i++)
+        {
+            if (BlockBuf[i] != data[i])
+            {
+                if (first == n)
+                {
+                    first = i;
+                }
+                last = i;
+                if ((BlockBuf[i] & data[i]) != data[i])
+                {
+                    erase = 1;
+                    break;
+                }
+            }
+        }
+
+        if (first == n)
+        {
+            OverwriteStats.unchanged++;
+        }
+        else if (!erase)
+        {
+            OverwriteStats.inPlace++;
+            flashSPAN_Write(address + first, &data[first], last - first + 1);
+        }
+        else
+        {
+            // Keep the rest of the block. Erased bytes are skipped when it is written back.
+            OverwriteStats.merged++;
+            volumeRead(address - offset, BlockBuf, FLASH_BLOCKSIZE);
+            memcpy(&BlockBuf[offset], data, n);
+            res = flashSPAN_EraseBlock((address - offset) / FLASH_BLOCKSIZE);
+            if (res != RES_OK)
+            {
+                return(res);
+            }
+            flashSPAN_Write(address - offset, BlockBuf, FLASH_BLOCKSIZE);
+        }
+
+        address += n;
+        data += n;
+        nBytes -= n;
+    }
+    return(RES_OK);
+}
+
+//--------------------------------------------------------------------------------------------------
+const flashSPAN_overwriteStats_t* flashSPAN_GetOverwriteStats(void)
+{
+    return(&OverwriteStats);
+}
+#endif
+
+#if FLASH_CACHE_LINES
+//--------------------------------------------------------------------------------------------------
+const flashSPAN_cacheStats_t* flashSPAN_GetCacheStats(void)
+{
+    return(&CacheStats);
+}
+
+//--------------------------------------------------------------------------------------------------
+void flashSPAN_ClearCacheStats(void)
+{
+    memset(&CacheStats, 0, sizeof(CacheStats));
+}
+
+//--------------------------------------------------------------------------------------------------
+void flashSPAN_FlushCache(void)
+{
+    uint16_t i;
+
+    for (i = 0; i < FLASH_CACHE_LINES; i++)
+    {
+        CacheTag[i] = LINE_NONE;
+#if FLASH_CACHE_LRU
+        CacheUsed[i] = 0;
+#else
+        CacheRef[i] = 0;
+#endif
+    }
+}
+#endif
+
 ///\}
 ///\}
 ///\}
@@ -17,19 +17,94 @@
  * Generic configuration defines for the \ref MOD_FLASHSPAN module
  *
  * \details
- *    - The total number of blocks can not exceed \c 0xFFFF
- *    - The total number of bytes can not exceed  \c 0xFFFFFFFF (4 GB)
+ *    - The volume must be smaller than 4 GB. Addresses and block numbers are 32-bit.
  *
  * \{
 **/
 //==================================================================================================
 
-/// Erase block size in bytes. Each device must have equal block sizes.
+/// Erase block size in bytes: 0x1000, 0x8000 or 0x10000. Every device must support erasing blocks of
+/// this size.
 #define FLASH_BLOCKSIZE        0x1000 ///< \hideinitializer
 
 /// Total number of devices in the volume
 #define FLASH_DEVICECOUNT        1  //,2 ///< \hideinitializer
 
+/// Stripe unit in bytes. Consecutive stripes of the volume go to consecutive devices (RAID-0).
+#define FLASH_STRIPE_SIZE          0 ///< \hideinitializer
+/**<    0 = Devices are concatenated. Device n follows device n-1 in the address space. \n
+*       Otherwise a power of two no larger than #FLASH_BLOCKSIZE. Writes program all devices at
+*       the same time. A multiple of the page size (e.g. 0x100) keeps page programs whole. All
+*       devices should be the same size: the smallest one sets the size of the volume.
+**/
+
+/// Mirror the volume on every device (RAID-1). Needs one-hot CE mode (#SST_CE_MODE 0) and all
+/// devices on one bus.
+#define FLASH_MIRROR               0 ///< \hideinitializer
+/**<    0 = Devices are concatenated or striped \n
+*       1 = Every device holds a copy of the volume. Writes and erases assert all CE lines and are
+*           sent once for all devices. Reads come from a device that is not busy. All devices must
+*           be the same part. Can not be combined with #FLASH_STRIPE_SIZE.
+**/
+
+/// Suspend a background erase to serve a read on devices that support it. Otherwise the read
+/// waits for the current erase command to finish.
+#define FLASH_ERASE_SUSPEND        1 ///< \hideinitializer
+
+/// Read a block before erasing it with flashSPAN_EraseBlock() and skip the erase if it is blank
+#define FLASH_ERASE_BLANK_CHECK    1 ///< \hideinitializer
+
+/// Asynchronous request API (flashSPAN_Submit()). Needs the concatenated layout.
+#define FLASH_ASYNC                1 ///< \hideinitializer
+/**<    0 = Only the blocking functions are available \n
+*       1 = Requests are queued per device and serviced by flashSPAN_Service(), one at a time on
+*           each device, in ascending address order (C-SCAN).
+**/
+
+/// Time source for the latency and utilization counters of flashSPAN_asyncStats_t. Must return a
+/// free running uint32_t count, e.g. of a timer. The target uses clockTicks() (about 1 us per
+/// tick), host builds the simulator's modeled time in us.
+#ifdef __MSP430__
+#include "clock.h"
+#if FLASH_ASYNC && !CLOCK_TICKS
+#error "FLASH_ASYNC_CLOCK() needs CLOCK_TICKS or another time source"
+#endif
+#define FLASH_ASYNC_CLOCK()        clockTicks() ///< \hideinitializer
+#else
+#include "SST25VF_sim.h"
+#define FLASH_ASYNC_CLOCK()        ((uint32_t)(sstSim_Now() / 1000))
+#endif
+
+/// Number of lines of the read cache of flashSPAN_Read()
+#define FLASH_CACHE_LINES          16 ///< \hideinitializer
+/**<    0 = No read cache \n
+*       n = Lines of #FLASH_CACHE_LINE_SIZE bytes, allocated statically. Writes and erases drop the
+*           lines they overlap. Reads larger than a quarter of the cache bypass it. RAM use is
+*           n * (#FLASH_CACHE_LINE_SIZE + 5) bytes, n * (#FLASH_CACHE_LINE_SIZE + 8) with
+*           #FLASH_CACHE_LRU: 1104 bytes for the default 16 lines of 64 bytes.
+**/
+
+/// Bytes per cache line. Power of 2, at most #FLASH_BLOCKSIZE.
+#define FLASH_CACHE_LINE_SIZE      64 ///< \hideinitializer
+
+/// Cache line replacement
+#define FLASH_CACHE_LRU            0 ///< \hideinitializer
+/**<    0 = CLOCK (one reference bit per line) \n
+*       1 = Least recently used (one 32-bit timestamp per line)
+**/
+
+/// Place the cache lines in the 2 KB USB RAM (\c .usbram section) instead of the main RAM. Only
+/// when the USB module is not used. The lines must fit in 2 KB.
+#define FLASH_CACHE_USBRAM         0 ///< \hideinitializer
+
+/// flashSPAN_Overwrite(), which writes over data that is not erased. Can not be combined with
+/// #FLASH_STRIPE_SIZE.
+#define FLASH_OVERWRITE            0 ///< \hideinitializer
+/**<    0 = Not available \n
+*       1 = Available. Costs a static buffer of #FLASH_BLOCKSIZE bytes of main RAM (4 KB, half of
+*           the F5529's RAM, with 4K blocks). The buffer does not fit in the 2 KB USB RAM.
+**/
+
 ///\}
 
 #endif
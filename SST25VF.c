@@ -46,7 +46,11 @@
 #include    <string.h>
 
 //#include "msp430_xc.h"
+#ifdef __MSP430__
 #include 	<msp430.h>
+#else
+#include    "SST25VF_sim.h"
+#endif
 #include    "SST25VF.h"
 #include    "spi.h"
 
@@ -56,13 +60,39 @@
 ///\cond INTERNAL
 
 static uint8_t CurrentDevice; // represents the current selected device
+static spiBus_t *Bus = SPI_BUS_DEFAULT; // bus of the current device
+
+// Device with an open background read on each bus, plus one. 0 = none.
+static uint8_t Pending[SPI_BUS_COUNT];
 
 #if SST_CE_MODE == 0
+// Devices 0-7 have their CE on SST_CE_POUT, devices 8-15 on SST_CE_POUT1. A CE mask holds the
+// SST_CE_POUT bits in its low byte and the SST_CE_POUT1 bits in its high byte.
 #define SST_CE_DEVMASK    (SST_CE_DEV0_BIT|SST_CE_DEV1_BIT|SST_CE_DEV2_BIT|SST_CE_DEV3_BIT|\
                             SST_CE_DEV4_BIT|SST_CE_DEV5_BIT|SST_CE_DEV6_BIT|SST_CE_DEV7_BIT)
+#define SST_CE_DEVMASK1   (SST_CE_DEV8_BIT|SST_CE_DEV9_BIT|SST_CE_DEV10_BIT|SST_CE_DEV11_BIT|\
+                            SST_CE_DEV12_BIT|SST_CE_DEV13_BIT|SST_CE_DEV14_BIT|SST_CE_DEV15_BIT)
+
+// Chip-enable line control. Host builds drive the simulated devices instead of a port.
+#ifdef __MSP430__
+#if SST_CE_DEVMASK1
+#define CE_LOW(mask)     do {SST_CE_POUT &= ~(uint8_t)(mask); SST_CE_POUT1 &= ~(uint8_t)((mask) >> 8);} while (0)
+#define CE_HIGH(mask)    do {SST_CE_POUT |= (uint8_t)(mask); SST_CE_POUT1 |= (uint8_t)((mask) >> 8);} while (0)
+#else
+#define CE_LOW(mask)     (SST_CE_POUT &= ~(uint8_t)(mask))
+#define CE_HIGH(mask)    (SST_CE_POUT |= (uint8_t)(mask))
+#endif
+#else
+#define CE_LOW(mask)     sstSim_CE((mask), 0)
+#define CE_HIGH(mask)    sstSim_CE((mask), 1)
+#endif
 
-static uint8_t CE_Mask;
-static const uint8_t CE_MAP[] =
+static uint16_t CE_Mask;
+
+// Devices selected together by sst25vf_SetBroadcast(), one bit per device. 0 = only CurrentDevice.
+static uint16_t Broadcast;
+
+static const uint16_t CE_MAP[] =
 {
     SST_CE_DEV0_BIT,
     SST_CE_DEV1_BIT,
@@ -71,8 +101,37 @@ static const uint8_t CE_MAP[] =
     SST_CE_DEV4_BIT,
     SST_CE_DEV5_BIT,
     SST_CE_DEV6_BIT,
-    SST_CE_DEV7_BIT
+    SST_CE_DEV7_BIT,
+    SST_CE_DEV8_BIT << 8,
+    SST_CE_DEV9_BIT << 8,
+    SST_CE_DEV10_BIT << 8,
+    SST_CE_DEV11_BIT << 8,
+    SST_CE_DEV12_BIT << 8,
+    SST_CE_DEV13_BIT << 8,
+    SST_CE_DEV14_BIT << 8,
+    SST_CE_DEV15_BIT << 8
+};
+static const uint8_t BUS_MAP[] =
+{
+    SST_DEV0_BUS,
+    SST_DEV1_BUS,
+    SST_DEV2_BUS,
+    SST_DEV3_BUS,
+    SST_DEV4_BUS,
+    SST_DEV5_BUS,
+    SST_DEV6_BUS,
+    SST_DEV7_BUS,
+    SST_DEV8_BUS,
+    SST_DEV9_BUS,
+    SST_DEV10_BUS,
+    SST_DEV11_BUS,
+    SST_DEV12_BUS,
+    SST_DEV13_BUS,
+    SST_DEV14_BUS,
+    SST_DEV15_BUS
 };
+#define SST_MAX_DEVICES    (sizeof(CE_MAP) / sizeof(CE_MAP[0]))
+#define DEV_BUS(device)    (&spiBus[BUS_MAP[device]])
 #else
 #if(SST_ADDR_WIDTH == 2)
 #define ADDR_MASK    (0x03)
@@ -91,271 +150,1848 @@ static const uint8_t CE_MAP[] =
 #else
 #error "Invalid SST_ADDR_WIDTH"
 #endif
+#define SST_MAX_DEVICES    (ADDR_MASK + 1)
+#define DEV_BUS(device)    SPI_BUS_DEFAULT // one decoder, so all devices share one bus
+
+// Decoder control. The address lines are only changed while the decoder is disabled. Host builds
+// give device n of the simulator the CE mask (1 << n).
+#ifdef __MSP430__
+#define DECODER_SELECT(device)  do {SST_ADDR_POUT = (SST_ADDR_POUT & ~ADDR_MASK) | ((device) & ADDR_MASK); \
+                                    SST_ADDR_EN_POUT &= ~SST_ADDR_EN_BIT;} while (0)
+#define DECODER_RELEASE(device) (SST_ADDR_EN_POUT |= SST_ADDR_EN_BIT)
+#else
+#if SST_ADDR_WIDTH > 4
+#error "The simulator supports at most 16 devices in SST_CE_MODE 1"
+#endif
+#define DECODER_SELECT(device)  sstSim_CE((uint16_t)1 << (device), 0)
+#define DECODER_RELEASE(device) sstSim_CE((uint16_t)1 << (device), 1)
+#endif
 #endif
 
-static void SendAddr(uint32_t addr)
+// Bus profile of each device. Selected when the device's CE is asserted.
+static spiProfile_t DevProfile[SST_MAX_DEVICES];
+
+// Nonzero if the device is read with its fast-read command
+static uint8_t DevFastRead[SST_MAX_DEVICES];
+
+// Capabilities of each device. NULL until the device has been identified.
+static const sst25vf_info_t *DevInfo[SST_MAX_DEVICES];
+
+#if SST_USE_SPI_QUEUE
+// Nonzero if the device is ready once its queued transactions are done: the last one queued was
+// a busy poll. Cleared by every write or erase issued outside the queue.
+static uint8_t DevQueueReady[SST_MAX_DEVICES];
+#endif
+
+// Address of the next word of the AAI sequence left open by sst25vf_ProgramStart()
+#define AAI_NONE        0xFFFFFFFFUL
+static uint32_t DevAAINext[SST_MAX_DEVICES];
+
+// Write stream of sst25vf_WriteBegin()
+static uint32_t StreamAddr;     // address of the next byte
+static uint16_t StreamLeft;     // bytes left in the open page program window
+static uint8_t StreamOpen;      // a page program window or AAI sequence is open
+static uint8_t StreamHw;        // the AAI sequence uses hardware end-of-write detection
+static uint8_t StreamCarry;     // first byte of an AAI word split between two segments
+static uint8_t StreamHasCarry;
+
+#if SST_CACHE_STATUS
+// Known state of each device (DevState bits)
+#define ST_SR_VALID     0x01    // DevSR holds the status register
+#define ST_BUSY         0x02    // a write or erase may be in progress
+#define ST_WEL          0x04    // WEL is set
+#define ST_EBSY_VALID   0x08    // ST_EBSY is known
+#define ST_EBSY         0x10    // SO outputs RY/BY# during AAI
+static uint8_t DevState[SST_MAX_DEVICES];
+
+// Status register of each device without BUSY and WEL
+static uint8_t DevSR[SST_MAX_DEVICES];
+
+sst25vf_elided_t sst25vf_Elided;
+#endif
+
+#define SST_ERASE    {SST_ERASE4k, SST_ERASE32k, SST_ERASE64k}
+#define SST_FLAGS    (SST_CAP_EWSR | SST_CAP_EBSY)
+
+// Supported devices. Adding a device only takes an entry here. Timings are datasheet typicals.
+static const sst25vf_info_t DEV_INFO[] =
+{
+    // id, jedec, size, erase opcodes, write mode, page size, fast read,
+    //   maxClk, maxReadClk, flags, erase times (ms), chip erase (ms), program cycle (us)
+    {SST25VF040_ID, SST25VF040_JEDEC, SST25VF040_SIZE, SST_ERASE, SST_WRITE_AAI, 0, SST_HSRD,
+        50000000L, 25000000L, SST_FLAGS, {18, 18, 18}, 35, 7},
+    {SST25VF080_ID, SST25VF080_JEDEC, SST25VF080_SIZE, SST_ERASE, SST_WRITE_AAI, 0, SST_HSRD,
+        50000000L, 25000000L, SST_FLAGS, {18, 18, 18}, 35, 7},
+    {SST25VF016_ID, SST25VF016_JEDEC, SST25VF016_SIZE, SST_ERASE, SST_WRITE_AAI, 0, SST_HSRD,
+        50000000L, 25000000L, SST_FLAGS, {18, 18, 18}, 35, 7},
+    {SST25VF032_ID, SST25VF032_JEDEC, SST25VF032_SIZE, SST_ERASE, SST_WRITE_AAI, 0, SST_HSRD,
+        66000000L, 25000000L, SST_FLAGS, {18, 18, 18}, 35, 7},
+    // Clocks and timing for ultra low power mode (the power-up default)
+    {MX25R1035F_ID, MX25R1035F_JEDEC, SST25VF010_SIZE, SST_ERASE, SST_WRITE_PAGE, 256, SST_HSRD,
+        33000000L, 33000000L, SST_CAP_SUSPEND, {40, 200, 400}, 1200, 850}
+};
+
+//--------------------------------------------------------------------------------------------------
+static const sst25vf_info_t* findDevInfo(uint16_t id)
+{
+    uint8_t i;
+    for (i = 0; i < (sizeof(DEV_INFO) / sizeof(DEV_INFO[0])); i++)
+    {
+        if (DEV_INFO[i].id == id)
+        {
+            return(&DEV_INFO[i]);
+        }
+    }
+    return(0);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Erase type of a block size or SST_ETYPE_COUNT if there is none
+static uint8_t eraseType(uint32_t size)
 {
-    spiSendByte((addr & 0xFF0000) >> 16);
-    spiSendByte((addr & 0xFF00) >> 8);
-    spiSendByte(addr & 0xFF);
+    switch (size)
+    {
+    case 0x1000:
+        return(SST_ETYPE_4K);
+    case 0x8000:
+        return(SST_ETYPE_32K);
+    case 0x10000:
+        return(SST_ETYPE_64K);
+    default:
+        return(SST_ETYPE_COUNT);
+    }
 }
 
 //--------------------------------------------------------------------------------------------------
-static void sst_CE(void)
+static void applyProfile(uint8_t device)
 {
-#if SST_CE_MODE == 0
-    SST_CE_POUT &= ~CE_Mask;
-	//SST_CE_POUT &=  ~CE;
-#else
-    SST_ADDR_EN_POUT &= ~SST_ADDR_EN_BIT;
-#endif
+    if (DevProfile[device].clkDiv) // not set until the device has been initialized
+    {
+        spiBusSetProfile(DEV_BUS(device), &DevProfile[device]);
+    }
 }
 
 //--------------------------------------------------------------------------------------------------
-static void sst_nCE(void)
+static void ceAssert(uint8_t device)
 {
+    applyProfile(device);
 #if SST_CE_MODE == 0
-    SST_CE_POUT |= SST_CE_DEVMASK;
-	//SST_CE_POUT |= CE;
+    CE_LOW(CE_MAP[device]);
 #else
-    SST_ADDR_EN_POUT |= SST_ADDR_EN_BIT;
+    DECODER_SELECT(device);
 #endif
 }
 
-///\endcond
-//==================================================================================================
-// Functions
-//==================================================================================================
-
-void sst25vf_SetCurrentDevice(uint8_t device)
+//--------------------------------------------------------------------------------------------------
+static void ceRelease(uint8_t device)
 {
-    CurrentDevice = device;
 #if SST_CE_MODE == 0
-    CE_Mask = CE_MAP[device];
+    CE_HIGH(CE_MAP[device]);
 #else
-    SST_ADDR_POUT &= ~ADDR_MASK;
-    SST_ADDR_POUT |= (device & ADDR_MASK)
+    DECODER_RELEASE(device);
 #endif
 }
 
+#if SST_USE_SPI_QUEUE
 //--------------------------------------------------------------------------------------------------
-uint8_t sst25vf_GetCurrentDevice(void)
+static void queueSelect(uint8_t target, uint8_t enable)
 {
-    return(CurrentDevice);
+    if (enable)
+    {
+        ceAssert(target);
+    }
+    else
+    {
+        ceRelease(target);
+    }
 }
 
 //--------------------------------------------------------------------------------------------------
-/**
-* \brief Initializes the SPI controller and attempts to identify the device.
-* \return SST25VF Device ID
-* \attention The initialization routine does \e not setup the IO ports!
-**/
-uint16_t sst25vf_Init(void)
+static void putAddr(uint8_t *buf, uint32_t addr)
 {
-    uint16_t id;
+    buf[0] = (addr & 0xFF0000) >> 16;
+    buf[1] = (addr & 0xFF00) >> 8;
+    buf[2] = addr & 0xFF;
+}
 
-    // Init SPI
-    spiInit(SPI_MODE0);
+//--------------------------------------------------------------------------------------------------
+// Takes n descriptors from the pool, all or none. Returns 0 if the pool ran out.
+static uint8_t queueAlloc(spiTransaction_t **t, uint8_t n)
+{
+    uint8_t i;
 
-    // attempt to ID device
-    id = sst25vf_RDID();
-    switch (id)
+    for (i = 0; i < n; i++)
     {
-    case SST25VF040_ID:
-        break;
-    case SST25VF080_ID:
-        break;
-    case SST25VF016_ID:
-        break;
-    case SST25VF032_ID:
-        break;
-    case MX25R1035F_ID:
-        break;
-    default:
-        return(SST_INVALID_ID);
+        t[i] = spiQueueAlloc();
+        if (t[i] == 0)
+        {
+            while (i--)
+            {
+                spiQueueFree(t[i]);
+            }
+            return(0);
+        }
     }
-    sst25vf_WRSR(0x00);
-    sst25vf_DBSY();
-    printf("id = %x \n",id);
-    return(id);
+    return(1);
 }
 
 //--------------------------------------------------------------------------------------------------
-uint8_t sst25vf_RDSR(void)
+// Returns 1 if a queued command to the current device has to poll BUSY first
+static uint8_t queueNeedsPoll(void)
 {
-    uint8_t result;
-    sst_CE();
-    spiSendByte(SST_RDSR);
-    result = spiGetByte();
-    sst_nCE();
-    return(result);
+    if (DevQueueReady[CurrentDevice])
+    {
+        return(0);
+    }
+#if SST_CACHE_STATUS
+    if (!(DevState[CurrentDevice] & ST_BUSY))
+    {
+        sst25vf_Elided.RDSR++;
+        return(0);
+    }
+#endif
+    return(1);
 }
 
 //--------------------------------------------------------------------------------------------------
-void sst25vf_WRSR(uint8_t status)
+// Fills a descriptor that reads the status register of the current device until BUSY is clear
+static void makePoll(spiTransaction_t *t)
 {
-    sst25vf_EWSR();
-    sst_CE();
-    spiSendByte(SST_WRSR);
-    spiSendByte(status);
-    sst_nCE();
+    t->bus = Bus;
+    t->target = CurrentDevice;
+    t->header[0] = SST_RDSR;
+    t->headerLen = 1;
+    t->dir = SPIQ_DIR_POLL;
+    t->pollMask = SST_BUSY;
 }
+#endif
 
 //--------------------------------------------------------------------------------------------------
-void sst25vf_StallBusy(void)
+static void SendCmdAddr(uint8_t cmd, uint32_t addr)
 {
-    while ((sst25vf_RDSR() & SST_BUSY) != 0);
+    uint8_t buf[4];
+    buf[0] = cmd;
+    buf[1] = (addr & 0xFF0000) >> 16;
+    buf[2] = (addr & 0xFF00) >> 8;
+    buf[3] = addr & 0xFF;
+    spiBusSendFrame(Bus, buf, 4);
 }
 
 //--------------------------------------------------------------------------------------------------
-void sst25vf_CMD(uint8_t data)
+// Read command of the current device. Returns the header length.
+static uint8_t makeReadHeader(uint8_t *buf, uint32_t addr)
 {
-    sst_CE();
-    spiSendByte(data);
-    sst_nCE();
+    buf[0] = SST_RD;
+    buf[1] = (addr & 0xFF0000) >> 16;
+    buf[2] = (addr & 0xFF00) >> 8;
+    buf[3] = addr & 0xFF;
+    if (DevFastRead[CurrentDevice])
+    {
+        buf[0] = DevInfo[CurrentDevice]->fastReadCmd;
+        buf[4] = DUMMY_CHAR;
+        return(5);
+    }
+    return(4);
 }
 
 //--------------------------------------------------------------------------------------------------
-void sst25vf_Read(uint32_t startAddr, uint8_t *data, uint16_t nBytes)
+// Complete the background read on a bus, if any, and release its CE
+static void finishPending(spiBus_t *bus)
 {
-    uint16_t i;
-    sst_CE();
-    spiSendByte(SST_RD);
-    SendAddr(startAddr);
-    for (i = 0; i < nBytes; i++)
+    uint8_t device = Pending[bus->index];
+    if (device)
     {
-        data[i] = spiGetByte();
+        spiBusWaitFrame(bus);
+        ceRelease(device - 1);
+        Pending[bus->index] = 0;
     }
-    sst_nCE();
 }
 
 //--------------------------------------------------------------------------------------------------
-void sst25vf_WriteSlow(uint32_t startAddr, const uint8_t *data, uint16_t nBytes)
+static void sst_CE(void)
 {
-    uint16_t i;
-    for (i = 0; i < nBytes; i++)
+#if SST_USE_SPI_QUEUE
+    spiQueueWait(Bus);
+#endif
+#if SST_CE_MODE == 0
+    finishPending(Bus);
+#else
+    sst25vf_Sync(); // only one device can be selected through the decoder
+#endif
+#if SST_CE_MODE == 0
+    applyProfile(CurrentDevice);
+    CE_LOW(CE_Mask);
+	//SST_CE_POUT &=  ~CE;
+#else
+    ceAssert(CurrentDevice); // address lines may have been changed by a queued transaction
+#endif
+}
+
+//--------------------------------------------------------------------------------------------------
+static void sst_nCE(void)
+{
+#if SST_CE_MODE == 0
+    CE_HIGH(CE_Mask);
+	//SST_CE_POUT |= CE;
+#else
+    DECODER_RELEASE(CurrentDevice);
+#endif
+}
+
+//--------------------------------------------------------------------------------------------------
+// Record that a write or erase command was issued to the current device. The device is busy and
+// clears WEL once done.
+static void sst_WriteIssued(void)
+{
+#if SST_USE_SPI_QUEUE
+    DevQueueReady[CurrentDevice] = 0;
+#if SST_CE_MODE == 0
+    if (Broadcast)
     {
-        sst25vf_WriteByte(startAddr + i, data[i]);
+        memset(DevQueueReady, 0, sizeof(DevQueueReady));
     }
+#endif
+#endif
+#if SST_CACHE_STATUS
+#if SST_CE_MODE == 0
+    uint8_t device;
+
+    if (Broadcast)
+    {
+        for (device = 0; device < SST_MAX_DEVICES; device++)
+        {
+            if (Broadcast & ((uint16_t)1 << device))
+            {
+                DevState[device] = (DevState[device] & ~ST_WEL) | ST_BUSY;
+            }
+        }
+        return;
+    }
+#endif
+    DevState[CurrentDevice] = (DevState[CurrentDevice] & ~ST_WEL) | ST_BUSY;
+#endif
 }
 
+#if SST_CE_MODE == 0
 //--------------------------------------------------------------------------------------------------
-void sst25vf_WriteByte(uint32_t startAddr, const uint8_t data)
+// Calls fn for each device of the broadcast group with that device selected alone. Returns the OR
+// of the results. Status must be read from one device at a time.
+static uint8_t forEachBroadcast(uint8_t (*fn)(void))
 {
-    sst25vf_WREN();
-    sst_CE();
-    spiSendByte(SST_WRBYTE);
-    SendAddr(startAddr);
-    spiSendByte(data);
-    sst_nCE();
-    sst25vf_StallBusy();
+    uint16_t group = Broadcast;
+    uint16_t mask = CE_Mask;
+    uint8_t lead = CurrentDevice;
+    uint8_t device;
+    uint8_t result = 0;
+
+    Broadcast = 0;
+    for (device = 0; device < SST_MAX_DEVICES; device++)
+    {
+        if (group & ((uint16_t)1 << device))
+        {
+            CurrentDevice = device;
+            CE_Mask = CE_MAP[device];
+            result |= fn();
+        }
+    }
+    CurrentDevice = lead;
+    CE_Mask = mask;
+    Broadcast = group;
+    return(result);
 }
+#endif
+
+#if SST_USE_SFDP
+// Geometry of devices discovered through SFDP
+static sst25vf_info_t SfdpInfo[SST_MAX_DEVICES];
 
 //--------------------------------------------------------------------------------------------------
-void sst25vf_Write(uint32_t startAddr, const uint8_t *data, uint16_t nBytes)
+// Read DWORD n (1-based) of an SFDP parameter table
+static uint32_t sfdpDword(uint32_t ptp, uint8_t n)
 {
-    uint16_t i;
+    uint8_t buf[4];
+    sst25vf_ReadSFDP(ptp + 4 * (n - 1), buf, 4);
+    return(((uint32_t)buf[3] << 24) | ((uint32_t)buf[2] << 16) | ((uint16_t)buf[1] << 8) | buf[0]);
+}
 
-    // If odd start address
-    if (startAddr & 0x01)
+//--------------------------------------------------------------------------------------------------
+// Convert an SFDP time field (count, then a unit of unitBits) to ms or us
+static uint16_t sfdpTime(uint32_t dw, uint8_t shift, uint8_t countBits, uint8_t unitBits,
+                         const uint16_t *units)
+{
+    uint32_t t;
+    t = ((dw >> shift) & ((1 << countBits) - 1)) + 1;
+    t *= units[(dw >> (shift + countBits)) & ((1 << unitBits) - 1)];
+    return((t > 0xFFFF) ? 0xFFFF : t);
+}
+
+//--------------------------------------------------------------------------------------------------
+/*
+* Reads the JEDEC SFDP Basic Flash Parameter Table (JESD216) of the current device into
+* SfdpInfo. Values that SFDP does not describe come from base, the built-in table entry (may
+* be NULL). Returns NULL if the device has no SFDP table or needs 4-byte addressing.
+*/
+static const sst25vf_info_t* sfdpDiscover(uint16_t id, const sst25vf_info_t *base)
+{
+    static const uint16_t ERASE_UNITS[] = {1, 16, 128, 1000};       // ms
+    static const uint16_t CHIP_UNITS[] = {16, 256, 4000, 64000};    // ms
+    static const uint16_t PROG_UNITS[] = {8, 64};                   // us
+    sst25vf_info_t *info = &SfdpInfo[CurrentDevice];
+    uint8_t hdr[8];
+    uint8_t len;
+    uint8_t t;
+    uint8_t type;
+    uint32_t ptp;
+    uint32_t dw;
+    uint32_t dw10;
+
+    // SFDP header, followed by the first parameter header, which is always the BFPT
+    sst25vf_ReadSFDP(0, hdr, 4);
+    if ((hdr[0] != 'S') || (hdr[1] != 'F') || (hdr[2] != 'D') || (hdr[3] != 'P'))
     {
-        // write 1 byte
-        sst25vf_WriteByte(startAddr, data[0]);
-        startAddr++;
-        nBytes--;
-        data++;
+        return(0);
+    }
+    sst25vf_ReadSFDP(8, hdr, 8);
+    len = hdr[3];
+    ptp = ((uint32_t)hdr[6] << 16) | ((uint16_t)hdr[5] << 8) | hdr[4];
+    if ((hdr[0] != 0x00) || (len < 9))
+    {
+        return(0);
     }
 
-    if (nBytes == 0)
+    if (base)
     {
-        return; // only one byte. End
+        *info = *base;
+    }
+    else
+    {
+        memset(info, 0, sizeof(sst25vf_info_t));
+        info->id = id;
+        info->jedec = sst25vf_JEDECID();
+        info->fastReadCmd = SST_HSRD;
+        info->maxClk = SST_SFDP_MAX_CLK;
+        info->maxReadClk = SST_SFDP_MAX_CLK;
     }
 
-    i = 0;
-    // Write pairs of bytes aligned to even addresses (AAI)
-    if (nBytes >= 2)
+    // DWORD 1: address bytes, 4K erase opcode, write granularity
+    dw = sfdpDword(ptp, 1);
+    if (((dw >> 17) & 0x03) == 0x02)
     {
-        sst25vf_AAIStart(startAddr, data[i], data[i + 1]);
-        i += 2;
-        nBytes -= 2;
-        sst25vf_StallBusy();
+        return(0); // 4-byte addresses only
+    }
+    info->pageSize = (dw & 0x04) ? 64 : 1;
 
-        while (nBytes >= 2)
+    // DWORD 2: density
+    dw = sfdpDword(ptp, 2);
+    if (dw & 0x80000000)
+    {
+        if ((dw & 0x7FFFFFFF) > 27)
         {
-            sst25vf_AAICont(data[i], data[i + 1]);
-            i += 2;
-            nBytes -= 2;
-            sst25vf_StallBusy();
+            return(0); // larger than 16 MB
         }
-        sst25vf_WRDI();
-        sst25vf_StallBusy();
+        info->size = (1UL << (dw & 0x7FFFFFFF)) >> 3;
+    }
+    else
+    {
+        if (dw >= 0x08000000)
+        {
+            return(0);
+        }
+        info->size = (dw >> 3) + 1;
     }
 
-    // if one byte remaining
-    if (nBytes)
+    // DWORDs 8-9: erase types. DWORD 10: erase times.
+    memset(info->eraseCmd, 0, sizeof(info->eraseCmd));
+    dw10 = (len >= 10) ? sfdpDword(ptp, 10) : 0;
+    for (t = 0; t < 4; t++)
     {
-        // write 1 byte
-        startAddr += i;
-        sst25vf_WriteByte(startAddr, data[i]);
+        if ((t & 1) == 0)
+        {
+            dw = sfdpDword(ptp, 8 + t / 2);
+        }
+        else
+        {
+            dw >>= 16;
+        }
+        if ((dw & 0xFF) > 31)
+        {
+            continue;
+        }
+        type = eraseType(1UL << (dw & 0xFF));
+        if (type < SST_ETYPE_COUNT)
+        {
+            info->eraseCmd[type] = (dw >> 8) & 0xFF;
+            if (dw10)
+            {
+                info->eraseTimeMs[type] = sfdpTime(dw10, 4 + 7 * t, 5, 2, ERASE_UNITS);
+            }
+        }
+    }
+
+    // DWORD 11: page size, program and chip erase times
+    if (len >= 11)
+    {
+        dw = sfdpDword(ptp, 11);
+        info->pageSize = 1 << ((dw >> 4) & 0x0F);
+        info->progTimeUs = sfdpTime(dw, 8, 5, 1, PROG_UNITS);   // bit 14 starts the byte times
+        info->chipEraseMs = sfdpTime(dw, 24, 5, 2, CHIP_UNITS);
+    }
+    info->writeMode = (info->pageSize > 1) ? SST_WRITE_PAGE : SST_WRITE_BYTE;
+
+    // DWORD 12: suspend/resume (JESD216A and later). The bit is 0 if supported.
+    if (len >= 12)
+    {
+        dw = sfdpDword(ptp, 12);
+        info->flags &= ~SST_CAP_SUSPEND;
+        if ((dw & 0x80000000) == 0)
+        {
+            info->flags |= SST_CAP_SUSPEND;
+        }
     }
+
+    return(info);
 }
+#endif
 
+#if SST_EOW_MODE != 0
 //--------------------------------------------------------------------------------------------------
-void sst25vf_AAIStart(uint32_t startAddr, const uint8_t D0, const uint8_t D1)
+// Assert CE and wait until RY/BY# on SO reports ready. The next command is then clocked in the same
+// CE window.
+static void sst_CEWaitReady(void)
 {
-    sst25vf_WREN();
     sst_CE();
-    spiSendByte(SST_WRAAI);
-    SendAddr(startAddr);
-    spiSendByte(D0);
-    spiSendByte(D1);
-    sst_nCE();
+#if (SST_EOW_MODE == 2) && defined(__MSP430__)
+    {
+        uint16_t gie = __get_SR_register() & GIE;
+
+        __disable_interrupt();
+        SST_RYBY_PIES &= ~SST_RYBY_BIT; // rising edge: busy -> ready
+        SST_RYBY_PIFG &= ~SST_RYBY_BIT;
+        SST_RYBY_PIE |= SST_RYBY_BIT;
+        while ((SST_RYBY_PIN & SST_RYBY_BIT) == 0)
+        {
+            // An edge between the test and the sleep leaves PIFG set, so the ISR wakes us at once
+            __bis_SR_register(LPM0_bits | GIE);
+            __disable_interrupt();
+        }
+        SST_RYBY_PIE &= ~SST_RYBY_BIT;
+        __bis_SR_register(gie);
+    }
+#else
+    while (spiBusSOMILevel(Bus) == 0);
+#endif
 }
 
 //--------------------------------------------------------------------------------------------------
-void sst25vf_AAICont(const uint8_t D0, const uint8_t D1)
+// Ends an AAI sequence once RY/BY# reports that the last word is done
+static void aaiEndHw(void)
 {
-    sst_CE();
-    spiSendByte(SST_WRAAI);
-    spiSendByte(D0);
-    spiSendByte(D1);
+    sst_CEWaitReady();
+    spiBusSendByte(Bus, SST_WRDI);
     sst_nCE();
+#if SST_CACHE_STATUS
+    // The device was ready for WRDI, so it is idle. EBSY stays enabled for the next AAI write; SO
+    // only outputs RY/BY# in AAI mode.
+    DevState[CurrentDevice] &= ~(ST_BUSY | ST_WEL);
+    sst25vf_Elided.DBSY++;
+#else
+    sst25vf_DBSY();
+#endif
 }
 
 //--------------------------------------------------------------------------------------------------
-void sst25vf_ChipErase(void)
+// AAI loop with hardware end-of-write detection
+static void writeAAIHw(uint32_t startAddr, const uint8_t *data, uint16_t nWords)
 {
-    sst25vf_WREN();
-    sst_CE();
-    spiSendByte(SST_CHIPERASE);
-    sst_nCE();
-    //for(int i=0; i< 50 ; i++);
+    uint8_t buf[3];
+
+    sst25vf_EBSY();
+    sst25vf_AAIStart(startAddr, data[0], data[1]);
+    data += 2;
+
+    buf[0] = SST_WRAAI;
+    while (--nWords)
+    {
+        buf[1] = *data++;
+        buf[2] = *data++;
+        sst_CEWaitReady();
+        spiBusSendFrame(Bus, buf, 3);
+        sst_nCE();
+    }
+
+    aaiEndHw();
+}
+
+#if (SST_EOW_MODE == 2) && defined(__MSP430__)
+//--------------------------------------------------------------------------------------------------
+#pragma vector=SST_RYBY_VECTOR
+__interrupt void sst_RYBY_ISR(void)
+{
+    SST_RYBY_PIFG &= ~SST_RYBY_BIT;
+    __bic_SR_register_on_exit(LPM0_bits);
+}
+#endif
+#endif
+
+///\endcond
+//==================================================================================================
+// Functions
+//==================================================================================================
+
+void sst25vf_SetCurrentDevice(uint8_t device)
+{
+    CurrentDevice = device;
+    Bus = DEV_BUS(device);
+#if SST_CE_MODE == 0
+    CE_Mask = CE_MAP[device];
+    Broadcast = 0;
+#endif
+    // In addressed mode the address lines are set by the next CE assertion. Changing them here
+    // would switch the decoder output while a background read holds it enabled.
+}
+
+#if SST_CE_MODE == 0
+//--------------------------------------------------------------------------------------------------
+/**
+* \brief Selects several devices at once, so that one command stream programs or erases all of them
+* \param [in] devices Device mask. Bit n selects device n.
+* \retval RES_OK
+* \retval RES_PARAMERR No device, or the devices are not on the same bus
+*
+* The CE lines of all devices are asserted together. The lowest device becomes the current device
+* and its bus profile and capabilities are used for all of them, so the devices should be of the
+* same type. \n
+* Only writes and erases may be issued while several devices are selected. Busy polling reads
+* the status of each device on its own, and sst25vf_Write() uses RDSR polling instead of RY/BY#
+* (which every device would drive on SO). Reads of #SST_WRITE_SKIP == 2 come from the current
+* device alone. sst25vf_SetCurrentDevice() ends the broadcast.
+**/
+RES_t sst25vf_SetBroadcast(uint16_t devices)
+{
+    uint8_t device;
+    uint8_t lead = SST_MAX_DEVICES;
+    uint16_t mask = 0;
+
+    for (device = 0; device < SST_MAX_DEVICES; device++)
+    {
+        if (devices & ((uint16_t)1 << device))
+        {
+            if (lead == SST_MAX_DEVICES)
+            {
+                lead = device;
+            }
+            else if (BUS_MAP[device] != BUS_MAP[lead])
+            {
+                return(RES_PARAMERR);
+            }
+            mask |= CE_MAP[device];
+        }
+    }
+    if (lead == SST_MAX_DEVICES)
+    {
+        return(RES_PARAMERR);
+    }
+
+    sst25vf_SetCurrentDevice(lead);
+    CE_Mask = mask;
+    if (devices != ((uint16_t)1 << lead))
+    {
+        Broadcast = devices;
+    }
+    return(RES_OK);
+}
+#endif
+
+//--------------------------------------------------------------------------------------------------
+uint8_t sst25vf_GetCurrentDevice(void)
+{
+    return(CurrentDevice);
+}
+
+//--------------------------------------------------------------------------------------------------
+/**
+* \brief Initializes the SPI controller and attempts to identify the device.
+* \return SST25VF Device ID
+* \attention The initialization routine does \e not setup the IO ports!
+*
+* The device is identified using the default profile from spi_config.h. Afterwards the device
+* is switched to the fastest bus profile it supports. If that profile is faster than the device
+* allows for #SST_RD, reads use #SST_HSRD instead (see #SST_FAST_READ). \n
+* With #SST_USE_SFDP the geometry is read from the device's SFDP table when it has one, so
+* devices that are not in the built-in table can be used as well.
+**/
+uint16_t sst25vf_Init(void)
+{
+    uint16_t id;
+    const sst25vf_info_t *info;
+
+    // Init SPI
+    spiBusInit(Bus, SPI_MODE0);
+#if SST_CE_MODE == 0
+#ifdef __MSP430__
+    SST_CE_PDIR |= SST_CE_DEVMASK;
+#if SST_CE_DEVMASK1
+    SST_CE_PDIR1 |= SST_CE_DEVMASK1;
+#endif
+#endif
+    CE_HIGH(SST_CE_DEVMASK | ((uint16_t)SST_CE_DEVMASK1 << 8));
+#else
+    DECODER_RELEASE(CurrentDevice);
+#endif
+#if SST_USE_SPI_QUEUE
+    spiQueueInit(queueSelect);
+#endif
+
+    // Identify the device using the default profile
+    DevProfile[CurrentDevice].clkSrc = SPI_CLK_SRC;
+    DevProfile[CurrentDevice].mode = SPI_MODE0;
+    DevProfile[CurrentDevice].clkDiv = SPI_CLK_DIV;
+    DevInfo[CurrentDevice] = 0;
+    DevAAINext[CurrentDevice] = AAI_NONE;
+#if SST_CACHE_STATUS
+    DevState[CurrentDevice] = ST_BUSY; // nothing is known after a reset of the MCU
+#endif
+#if SST_USE_SPI_QUEUE
+    DevQueueReady[CurrentDevice] = 0;
+#endif
+    id = sst25vf_RDID();
+    info = findDevInfo(id);
+#if SST_USE_SFDP
+    {
+        const sst25vf_info_t *sfdp = sfdpDiscover(id, info);
+        if (sfdp)
+        {
+            info = sfdp;
+        }
+    }
+#endif
+    if (info == 0)
+    {
+        return(SST_INVALID_ID);
+    }
+    DevInfo[CurrentDevice] = info;
+
+#if SST_FAST_READ
+    spiMakeProfile(&DevProfile[CurrentDevice], info->maxClk, SPI_MODE0);
+#else
+    spiMakeProfile(&DevProfile[CurrentDevice], info->maxReadClk, SPI_MODE0);
+#endif
+    DevFastRead[CurrentDevice] = (spiProfileClock(&DevProfile[CurrentDevice]) > info->maxReadClk);
+    sst25vf_WRSR(0x00);
+#if SST_CACHE_STATUS && (SST_EOW_MODE != 0)
+    // The first AAI write enables EBSY. RDSR polling is not used in AAI mode on these devices.
+    if (info->flags & SST_CAP_EBSY)
+    {
+        sst25vf_Elided.DBSY++;
+    }
+#else
+    if (info->flags & SST_CAP_EBSY)
+    {
+        sst25vf_DBSY();
+    }
+#endif
+    printf("id = %x \n",id);
+    return(id);
+}
+
+//--------------------------------------------------------------------------------------------------
+/**
+* \brief Get the capabilities of the current device
+* \return Pointer to the device's entry in the device table or \c NULL if it has not been identified
+*         by sst25vf_Init()
+**/
+const sst25vf_info_t* sst25vf_GetInfo(void)
+{
+    return(DevInfo[CurrentDevice]);
+}
+
+//--------------------------------------------------------------------------------------------------
+uint8_t sst25vf_RDSR(void)
+{
+    uint8_t result;
+    sst_CE();
+    spiBusSendByte(Bus, SST_RDSR);
+    result = spiBusGetByte(Bus);
+    sst_nCE();
+#if SST_CACHE_STATUS
+    DevSR[CurrentDevice] = result & ~(SST_BUSY | SST_WEL);
+    DevState[CurrentDevice] |= ST_SR_VALID;
+    if (!(result & SST_BUSY))
+    {
+        DevState[CurrentDevice] &= ~ST_BUSY;
+    }
+#endif
+    return(result);
+}
+
+//--------------------------------------------------------------------------------------------------
+void sst25vf_WRSR(uint8_t status)
+{
+    const sst25vf_info_t *info = DevInfo[CurrentDevice];
+
+#if SST_CACHE_STATUS
+    // Skip the write if the register already holds the value
+    if (!(DevState[CurrentDevice] & ST_SR_VALID))
+    {
+        sst25vf_RDSR();
+    }
+    if (DevSR[CurrentDevice] == (status & ~(SST_BUSY | SST_WEL)))
+    {
+        sst25vf_Elided.WRSR++;
+        return;
+    }
+#endif
+
+    if ((info == 0) || (info->flags & SST_CAP_EWSR))
+    {
+        sst25vf_EWSR();
+    }
+    else
+    {
+        sst25vf_WREN();
+    }
+    sst_CE();
+    spiBusSendByte(Bus, SST_WRSR);
+    spiBusSendByte(Bus, status);
+    sst_nCE();
+    sst_WriteIssued();
+#if SST_CACHE_STATUS
+    DevSR[CurrentDevice] = status & ~(SST_BUSY | SST_WEL);
+#endif
+    sst25vf_StallBusy(); // some devices take a write cycle
+}
+
+#if SST_CE_MODE == 0
+//--------------------------------------------------------------------------------------------------
+static uint8_t stallBusy(void)
+{
+    sst25vf_StallBusy();
+    return(0);
+}
+#endif
+
+//--------------------------------------------------------------------------------------------------
+void sst25vf_StallBusy(void)
+{
+#if SST_CE_MODE == 0
+    if (Broadcast)
+    {
+        forEachBroadcast(stallBusy);
+        return;
+    }
+#endif
+#if SST_CACHE_STATUS
+    if (!(DevState[CurrentDevice] & ST_BUSY))
+    {
+        sst25vf_Elided.RDSR++;
+        return;
+    }
+#endif
+    while ((sst25vf_RDSR() & SST_BUSY) != 0);
+}
+
+//--------------------------------------------------------------------------------------------------
+/**
+* \brief Check whether the current device is busy with a write or erase
+* \retval 0 Ready
+* \retval 1 Busy. With sst25vf_SetBroadcast(), any of the selected devices.
+**/
+uint8_t sst25vf_IsBusy(void)
+{
+#if SST_CE_MODE == 0
+    if (Broadcast)
+    {
+        return(forEachBroadcast(sst25vf_IsBusy));
+    }
+#endif
+#if SST_CACHE_STATUS
+    if (!(DevState[CurrentDevice] & ST_BUSY))
+    {
+        sst25vf_Elided.RDSR++;
+        return(0);
+    }
+#endif
+    return((sst25vf_RDSR() & SST_BUSY) ? 1 : 0);
+}
+
+#if SST_CACHE_STATUS
+//--------------------------------------------------------------------------------------------------
+// Applies a single byte command to the known state of a device. Returns 1 if the command would not
+// change it.
+static uint8_t cmdState(uint8_t *st, uint8_t cmd)
+{
+    switch (cmd)
+    {
+    case SST_WREN:
+        if (*st & ST_WEL)
+        {
+            return(1);
+        }
+        *st |= ST_WEL;
+        break;
+    case SST_WRDI:
+        *st &= ~ST_WEL;
+        break;
+    case SST_EBSY:
+        if ((*st & (ST_EBSY_VALID | ST_EBSY)) == (ST_EBSY_VALID | ST_EBSY))
+        {
+            return(1);
+        }
+        *st |= ST_EBSY_VALID | ST_EBSY;
+        break;
+    case SST_DBSY:
+        if ((*st & (ST_EBSY_VALID | ST_EBSY)) == ST_EBSY_VALID)
+        {
+            return(1);
+        }
+        *st = (*st | ST_EBSY_VALID) & ~ST_EBSY;
+        break;
+    case SST_RESUME:
+        *st = (*st & ~ST_WEL) | ST_BUSY;
+        break;
+    default:
+        break;
+    }
+    return(0);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Returns 1 if a single byte command would not change the known state of the selected devices
+static uint8_t cmdElided(uint8_t cmd)
+{
+    uint8_t elide;
+#if SST_CE_MODE == 0
+    uint8_t device;
+
+    if (Broadcast)
+    {
+        // Sent unless every device already is in the state
+        elide = 1;
+        for (device = 0; device < SST_MAX_DEVICES; device++)
+        {
+            if (Broadcast & ((uint16_t)1 << device))
+            {
+                elide &= cmdState(&DevState[device], cmd);
+            }
+        }
+    }
+    else
+#endif
+    {
+        elide = cmdState(&DevState[CurrentDevice], cmd);
+    }
+
+    if (elide)
+    {
+        switch (cmd)
+        {
+        case SST_WREN:
+            sst25vf_Elided.WREN++;
+            break;
+        case SST_EBSY:
+            sst25vf_Elided.EBSY++;
+            break;
+        case SST_DBSY:
+            sst25vf_Elided.DBSY++;
+            break;
+        default:
+            break;
+        }
+    }
+    return(elide);
+}
+#endif
+
+//--------------------------------------------------------------------------------------------------
+void sst25vf_CMD(uint8_t data)
+{
+#if SST_CACHE_STATUS
+    if (cmdElided(data))
+    {
+        return;
+    }
+#endif
+    sst_CE();
+    spiBusSendByte(Bus, data);
+    sst_nCE();
+}
+
+//--------------------------------------------------------------------------------------------------
+/**
+* \brief Reads from the current device
+*
+* Any length up to the end of the device is read in a single CE window. The device increments
+* the address by itself, so only one command header is sent.
+**/
+void sst25vf_Read(uint32_t startAddr, uint8_t *data, uint32_t nBytes)
+{
+    uint8_t buf[5];
+    uint16_t n;
+
+    sst_CE();
+    spiBusSendFrame(Bus, buf, makeReadHeader(buf, startAddr));
+    while (nBytes)
+    {
+        n = (nBytes > 0xFFFF) ? 0xFFFF : nBytes;
+        spiBusReadFrame(Bus, data, n);
+        data += n;
+        nBytes -= n;
+    }
+    sst_nCE();
+}
+
+//--------------------------------------------------------------------------------------------------
+/**
+* \brief Starts a read that completes in the background
+*
+* If the bus of the current device has DMA channels, the data is transferred by DMA and the
+* device's CE stays asserted until the transfer is completed by sst25vf_Sync() or by the next
+* access to the same bus. Devices on other buses can be accessed in the meantime. \n
+* Otherwise the read is performed immediately.
+**/
+void sst25vf_ReadStart(uint32_t startAddr, uint8_t *data, uint16_t nBytes)
+{
+    uint8_t buf[5];
+
+    if ((nBytes < SPI_DMA_MIN_FRAME) || !spiBusHasDMA(Bus))
+    {
+        sst25vf_Read(startAddr, data, nBytes);
+        return;
+    }
+
+    sst_CE();
+    spiBusSendFrame(Bus, buf, makeReadHeader(buf, startAddr));
+    spiBusStartReadFrame(Bus, data, nBytes, 0);
+    Pending[Bus->index] = CurrentDevice + 1;
+}
+
+//--------------------------------------------------------------------------------------------------
+/**
+* \brief Completes all reads started by sst25vf_ReadStart()
+**/
+void sst25vf_Sync(void)
+{
+    uint8_t i;
+    for (i = 0; i < SPI_BUS_COUNT; i++)
+    {
+        finishPending(&spiBus[i]);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+void sst25vf_WriteSlow(uint32_t startAddr, const uint8_t *data, uint16_t nBytes)
+{
+    uint16_t i;
+    for (i = 0; i < nBytes; i++)
+    {
+        sst25vf_WriteByte(startAddr + i, data[i]);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+void sst25vf_WriteByte(uint32_t startAddr, const uint8_t data)
+{
+    sst25vf_WREN();
+    sst_CE();
+    SendCmdAddr(SST_WRBYTE, startAddr);
+    spiBusSendByte(Bus, data);
+    sst_nCE();
+    sst_WriteIssued();
+    sst25vf_StallBusy();
+}
+
+#if SST_WRITE_SKIP
+#if SST_WRITE_SKIP == 2
+// Read-back window of the current write
+static uint8_t SkipBuf[SST_SKIP_WINDOW];
+static uint32_t SkipBufAddr;
+static uint16_t SkipBufLen;
+#endif
+
+//--------------------------------------------------------------------------------------------------
+// Returns 1 if programming data at addr would not change the array
+static uint8_t isNoop(uint32_t addr, uint8_t data)
+{
+#if SST_WRITE_SKIP == 2
+    uint8_t cur;
+#endif
+
+    if (data == 0xFF)
+    {
+        return(1);
+    }
+#if SST_WRITE_SKIP == 2
+    if ((addr - SkipBufAddr) >= SkipBufLen)
+    {
+        SkipBufAddr = addr;
+        SkipBufLen = SST_SKIP_WINDOW;
+#if SST_CE_MODE == 0
+        {
+            // With a broadcast, read the current device alone
+            uint16_t mask = CE_Mask;
+            CE_Mask = CE_MAP[CurrentDevice];
+            sst25vf_Read(addr, SkipBuf, SST_SKIP_WINDOW);
+            CE_Mask = mask;
+        }
+#else
+        sst25vf_Read(addr, SkipBuf, SST_SKIP_WINDOW);
+#endif
+    }
+    cur = SkipBuf[addr - SkipBufAddr];
+
+    // programming only clears bits
+    return(((cur & data) == cur) ? 1 : 0);
+#else
+    (void)addr;
+    return(0);
+#endif
+}
+#endif
+
+//--------------------------------------------------------------------------------------------------
+// Page program in chunks that do not cross a page boundary
+static void writePages(uint32_t startAddr, const uint8_t *data, uint16_t nBytes, uint16_t pageSize)
+{
+    uint16_t n;
+#if SST_WRITE_SKIP
+    uint16_t skip;
+    uint16_t i;
+    uint16_t last;
+#endif
+
+    while (nBytes)
+    {
+        n = pageSize - (startAddr & (pageSize - 1));
+        if (n > nBytes)
+        {
+            n = nBytes;
+        }
+
+#if SST_WRITE_SKIP
+        // A page program takes the same time for any length, so only the ends are trimmed
+        for (skip = 0; (skip < n) && isNoop(startAddr + skip, data[skip]); skip++);
+        startAddr += skip;
+        data += skip;
+        nBytes -= skip;
+        n -= skip;
+        if (n == 0)
+        {
+            continue;
+        }
+        for (i = 1, last = 1; i < n; i++)
+        {
+            if (!isNoop(startAddr + i, data[i]))
+            {
+                last = i + 1;
+            }
+        }
+        skip = n - last;
+        n = last;
+#endif
+
+        sst25vf_WREN();
+        sst_CE();
+        SendCmdAddr(SST_WRBYTE, startAddr);
+        spiBusSendFrame(Bus, data, n);
+        sst_nCE();
+        sst_WriteIssued();
+        sst25vf_StallBusy();
+
+        startAddr += n;
+        data += n;
+#if SST_WRITE_SKIP
+        nBytes -= n + skip;
+        startAddr += skip;
+        data += skip;
+#else
+        nBytes -= n;
+#endif
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+// Word-pair AAI programming with single bytes at odd edges
+static void writeAAI(uint32_t startAddr, const uint8_t *data, uint16_t nBytes)
+{
+    uint16_t i;
+
+    // If odd start address
+    if (startAddr & 0x01)
+    {
+        // write 1 byte
+        sst25vf_WriteByte(startAddr, data[0]);
+        startAddr++;
+        nBytes--;
+        data++;
+    }
+
+    if (nBytes == 0)
+    {
+        return; // only one byte. End
+    }
+
+    i = 0;
+#if SST_EOW_MODE != 0
+#if SST_CE_MODE == 0
+    if (Broadcast && (nBytes >= 2) && DevInfo[CurrentDevice] && (DevInfo[CurrentDevice]->flags & SST_CAP_EBSY))
+    {
+        // Every selected device would drive RY/BY# on SO, so busy is polled with RDSR
+        sst25vf_DBSY();
+    }
+    else
+#endif
+    if ((nBytes >= 2) && DevInfo[CurrentDevice] && (DevInfo[CurrentDevice]->flags & SST_CAP_EBSY))
+    {
+        writeAAIHw(startAddr, data, nBytes / 2);
+        i = nBytes & ~1;
+        nBytes &= 1;
+    }
+#endif
+    // Write pairs of bytes aligned to even addresses (AAI)
+    if (nBytes >= 2)
+    {
+        sst25vf_AAIStart(startAddr, data[i], data[i + 1]);
+        i += 2;
+        nBytes -= 2;
+        sst25vf_StallBusy();
+
+        while (nBytes >= 2)
+        {
+            sst25vf_AAICont(data[i], data[i + 1]);
+            i += 2;
+            nBytes -= 2;
+            sst25vf_StallBusy();
+        }
+        sst25vf_WRDI();
+        sst25vf_StallBusy();
+    }
+
+    // if one byte remaining
+    if (nBytes)
+    {
+        // write 1 byte
+        startAddr += i;
+        sst25vf_WriteByte(startAddr, data[i]);
+    }
+}
+
+#if SST_WRITE_SKIP
+//--------------------------------------------------------------------------------------------------
+// AAI or byte write of the runs of data that change the array
+static void writeRuns(uint32_t startAddr, const uint8_t *data, uint16_t nBytes, uint8_t writeMode)
+{
+    uint16_t i;
+    uint16_t start;
+    uint16_t end;
+    uint16_t gap;
+    uint16_t minGap;
+
+    // Restarting AAI costs a few commands, so short gaps are programmed through
+    minGap = (writeMode == SST_WRITE_AAI) ? SST_SKIP_MIN_GAP : 1;
+
+    i = 0;
+    while (i < nBytes)
+    {
+        if (isNoop(startAddr + i, data[i]))
+        {
+            i++;
+            continue;
+        }
+
+        // extend the run up to the next long enough gap
+        start = i;
+        end = i + 1;
+        gap = 0;
+        for (i++; (i < nBytes) && (gap < minGap); i++)
+        {
+            if (isNoop(startAddr + i, data[i]))
+            {
+                gap++;
+            }
+            else
+            {
+                gap = 0;
+                end = i + 1;
+            }
+        }
+
+        if (writeMode == SST_WRITE_AAI)
+        {
+            // Programming a skippable byte is harmless. Widen the run to whole words so that it
+            // does not need single byte programs at its edges.
+            if (((startAddr + start) & 1) && (start > 0))
+            {
+                start--;
+            }
+            if (((startAddr + end) & 1) && (end < nBytes))
+            {
+                end++;
+            }
+            writeAAI(startAddr + start, data + start, end - start);
+        }
+        else
+        {
+            sst25vf_WriteSlow(startAddr + start, data + start, end - start);
+        }
+    }
+}
+#endif
+
+//--------------------------------------------------------------------------------------------------
+/**
+* \brief Writes to the current device using the write mode from its capability table entry
+*
+* AAI devices program a word per busy cycle, page-program devices up to a page. With
+* #SST_WRITE_SKIP, bytes that would not change the array are not sent.
+**/
+void sst25vf_Write(uint32_t startAddr, const uint8_t *data, uint16_t nBytes)
+{
+    const sst25vf_info_t *info = DevInfo[CurrentDevice];
+
+    if (nBytes == 0)
+    {
+        return;
+    }
+#if SST_WRITE_SKIP == 2
+    SkipBufLen = 0;
+#endif
+
+    switch (info ? info->writeMode : SST_WRITE_AAI)
+    {
+    case SST_WRITE_PAGE:
+        writePages(startAddr, data, nBytes, info->pageSize);
+        break;
+#if SST_WRITE_SKIP
+    case SST_WRITE_BYTE:
+        writeRuns(startAddr, data, nBytes, SST_WRITE_BYTE);
+        break;
+    default:
+        writeRuns(startAddr, data, nBytes, SST_WRITE_AAI);
+        break;
+#else
+    case SST_WRITE_BYTE:
+        sst25vf_WriteSlow(startAddr, data, nBytes);
+        break;
+    default:
+        writeAAI(startAddr, data, nBytes);
+        break;
+#endif
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+/**
+* \brief Starts a read whose data is collected in pieces by sst25vf_ReadCont()
+* \param [in] startAddr Address of the first byte
+*
+* CE stays asserted until sst25vf_ReadEnd(), so the pieces only cost one command header. No other
+* transaction may be issued on the bus in the meantime.
+**/
+void sst25vf_ReadBegin(uint32_t startAddr)
+{
+    uint8_t buf[5];
+
+    sst_CE();
+    spiBusSendFrame(Bus, buf, makeReadHeader(buf, startAddr));
+}
+
+//--------------------------------------------------------------------------------------------------
+/**
+* \brief Reads the next nBytes of a read started by sst25vf_ReadBegin()
+**/
+void sst25vf_ReadCont(uint8_t *data, uint16_t nBytes)
+{
+    spiBusReadFrame(Bus, data, nBytes);
+}
+
+//--------------------------------------------------------------------------------------------------
+/**
+* \brief Ends a read started by sst25vf_ReadBegin()
+**/
+void sst25vf_ReadEnd(void)
+{
+    sst_nCE();
+}
+
+///\cond INTERNAL
+//--------------------------------------------------------------------------------------------------
+// Programs one AAI word of the write stream. The first word starts the sequence.
+static void streamWord(uint8_t D0, uint8_t D1)
+{
+    const sst25vf_info_t *info = DevInfo[CurrentDevice];
+
+    if (!StreamOpen)
+    {
+        StreamHw = 0;
+        if (info && (info->flags & SST_CAP_EBSY))
+        {
+#if (SST_EOW_MODE != 0) && (SST_CE_MODE == 0)
+            StreamHw = !Broadcast;
+#elif SST_EOW_MODE != 0
+            StreamHw = 1;
+#endif
+            if (StreamHw)
+            {
+                sst25vf_EBSY();
+            }
+            else
+            {
+                sst25vf_DBSY(); // busy is polled with RDSR
+            }
+        }
+        sst25vf_AAIStart(StreamAddr, D0, D1);
+        StreamOpen = 1;
+    }
+#if SST_EOW_MODE != 0
+    else if (StreamHw)
+    {
+        uint8_t buf[3];
+
+        buf[0] = SST_WRAAI;
+        buf[1] = D0;
+        buf[2] = D1;
+        sst_CEWaitReady();
+        spiBusSendFrame(Bus, buf, 3);
+        sst_nCE();
+    }
+#endif
+    else
+    {
+        sst25vf_AAICont(D0, D1);
+    }
+
+    if (!StreamHw)
+    {
+        sst25vf_StallBusy();
+    }
+    StreamAddr += 2;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Closes the open page program window or AAI sequence of the write stream
+static void streamClose(void)
+{
+    const sst25vf_info_t *info = DevInfo[CurrentDevice];
+
+    if (!StreamOpen)
+    {
+        return;
+    }
+    StreamOpen = 0;
+    if (info && (info->writeMode == SST_WRITE_PAGE))
+    {
+        sst_nCE();
+        sst_WriteIssued();
+        sst25vf_StallBusy();
+        return;
+    }
+#if SST_EOW_MODE != 0
+    if (StreamHw)
+    {
+        aaiEndHw();
+        return;
+    }
+#endif
+    sst25vf_WRDI();
     sst25vf_StallBusy();
 }
+///\endcond
 
 //--------------------------------------------------------------------------------------------------
-void sst25vf_xErase(uint32_t Addr, uint8_t EraseCode)
+/**
+* \brief Starts a write whose data is supplied in pieces by sst25vf_WriteCont()
+* \param [in] startAddr Address of the first byte
+*
+* The pieces are programmed as if they were one buffer: a page program window stays open across
+* pieces up to the end of the page, and an AAI sequence continues across pieces (a word split
+* between two pieces is assembled). No other transaction may be issued on the bus until
+* sst25vf_WriteEnd(). #SST_WRITE_SKIP does not apply.
+**/
+void sst25vf_WriteBegin(uint32_t startAddr)
+{
+    StreamAddr = startAddr;
+    StreamOpen = 0;
+    StreamHasCarry = 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+/**
+* \brief Writes the next nBytes of a write started by sst25vf_WriteBegin()
+**/
+void sst25vf_WriteCont(const uint8_t *data, uint16_t nBytes)
+{
+    const sst25vf_info_t *info = DevInfo[CurrentDevice];
+    uint8_t mode = info ? info->writeMode : SST_WRITE_AAI;
+    uint16_t n;
+
+    while (nBytes)
+    {
+        if (mode == SST_WRITE_PAGE)
+        {
+            if (!StreamOpen)
+            {
+                StreamLeft = info->pageSize - (StreamAddr & (info->pageSize - 1));
+                sst25vf_WREN();
+                sst_CE();
+                SendCmdAddr(SST_WRBYTE, StreamAddr);
+                StreamOpen = 1;
+            }
+            n = (nBytes < StreamLeft) ? nBytes : StreamLeft;
+            spiBusSendFrame(Bus, data, n);
+            StreamAddr += n;
+            StreamLeft -= n;
+            data += n;
+            nBytes -= n;
+            if (StreamLeft == 0)
+            {
+                streamClose();
+            }
+        }
+        else if (StreamHasCarry)
+        {
+            StreamHasCarry = 0;
+            streamWord(StreamCarry, *data++);
+            nBytes--;
+        }
+        else if ((mode == SST_WRITE_BYTE) || (!StreamOpen && (StreamAddr & 0x01)))
+        {
+            sst25vf_WriteByte(StreamAddr++, *data++);
+            nBytes--;
+        }
+        else if (nBytes >= 2)
+        {
+            streamWord(data[0], data[1]);
+            data += 2;
+            nBytes -= 2;
+        }
+        else
+        {
+            StreamCarry = *data;
+            StreamHasCarry = 1;
+            nBytes = 0;
+        }
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+/**
+* \brief Ends a write started by sst25vf_WriteBegin() and waits until it is programmed
+**/
+void sst25vf_WriteEnd(void)
+{
+    streamClose();
+    if (StreamHasCarry)
+    {
+        // last byte of an AAI write ends on an even address
+        StreamHasCarry = 0;
+        sst25vf_WriteByte(StreamAddr, StreamCarry);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+void sst25vf_AAIStart(uint32_t startAddr, const uint8_t D0, const uint8_t D1)
+{
+    uint8_t buf[6];
+    buf[0] = SST_WRAAI;
+    buf[1] = (startAddr & 0xFF0000) >> 16;
+    buf[2] = (startAddr & 0xFF00) >> 8;
+    buf[3] = startAddr & 0xFF;
+    buf[4] = D0;
+    buf[5] = D1;
+
+    sst25vf_WREN();
+    sst_CE();
+    spiBusSendFrame(Bus, buf, 6);
+    sst_nCE();
+    sst_WriteIssued();
+}
+
+//--------------------------------------------------------------------------------------------------
+void sst25vf_AAICont(const uint8_t D0, const uint8_t D1)
+{
+    uint8_t buf[3];
+    buf[0] = SST_WRAAI;
+    buf[1] = D0;
+    buf[2] = D1;
+
+    sst_CE();
+    spiBusSendFrame(Bus, buf, 3);
+    sst_nCE();
+    sst_WriteIssued();
+}
+
+//--------------------------------------------------------------------------------------------------
+/**
+* \brief Starts one program cycle on the current device and returns without waiting for it
+* \param [in] startAddr Address to program
+* \param [in] data Data to program
+* \param [in] nBytes Number of bytes available at \c data
+* \return Number of bytes taken from \c data: up to the end of the page for page-program devices,
+*         one AAI word or one byte otherwise
+*
+* The device must be ready (see sst25vf_IsBusy()). On AAI devices, a call at the address following
+* the previous one continues the AAI sequence. sst25vf_ProgramFinish() must be called after the
+* last call. \n
+* Lets the caller program several devices at the same time, one cycle on each in turn.
+**/
+uint16_t sst25vf_ProgramStart(uint32_t startAddr, const uint8_t *data, uint16_t nBytes)
+{
+    const sst25vf_info_t *info = DevInfo[CurrentDevice];
+    uint8_t mode = info ? info->writeMode : SST_WRITE_AAI;
+    uint16_t n;
+
+    if (mode == SST_WRITE_PAGE)
+    {
+        n = info->pageSize - (startAddr & (info->pageSize - 1));
+        if (n > nBytes)
+        {
+            n = nBytes;
+        }
+        sst25vf_WREN();
+        sst_CE();
+        SendCmdAddr(SST_WRBYTE, startAddr);
+        spiBusSendFrame(Bus, data, n);
+        sst_nCE();
+        sst_WriteIssued();
+        return(n);
+    }
+
+    if (mode == SST_WRITE_AAI)
+    {
+        if (DevAAINext[CurrentDevice] == startAddr)
+        {
+            if (nBytes >= 2)
+            {
+                sst25vf_AAICont(data[0], data[1]);
+                DevAAINext[CurrentDevice] += 2;
+                return(2);
+            }
+        }
+        if (DevAAINext[CurrentDevice] != AAI_NONE)
+        {
+            sst25vf_WRDI();
+            DevAAINext[CurrentDevice] = AAI_NONE;
+        }
+        if (!(startAddr & 0x01) && (nBytes >= 2))
+        {
+            // Busy is polled with RDSR, so SO must not output RY/BY#
+            sst25vf_DBSY();
+            sst25vf_AAIStart(startAddr, data[0], data[1]);
+            DevAAINext[CurrentDevice] = startAddr + 2;
+            return(2);
+        }
+    }
+
+    // single byte
+    sst25vf_WREN();
+    sst_CE();
+    SendCmdAddr(SST_WRBYTE, startAddr);
+    spiBusSendByte(Bus, data[0]);
+    sst_nCE();
+    sst_WriteIssued();
+    return(1);
+}
+
+//--------------------------------------------------------------------------------------------------
+/**
+* \brief Waits for the last cycle started by sst25vf_ProgramStart() and ends an open AAI sequence
+**/
+void sst25vf_ProgramFinish(void)
+{
+    sst25vf_StallBusy();
+    if (DevAAINext[CurrentDevice] != AAI_NONE)
+    {
+        sst25vf_WRDI();
+        DevAAINext[CurrentDevice] = AAI_NONE;
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+void sst25vf_ChipErase(void)
+{
+    sst25vf_ChipEraseStart();
+    //for(int i=0; i< 50 ; i++);
+    sst25vf_StallBusy();
+}
+
+//--------------------------------------------------------------------------------------------------
+/**
+* \brief Starts a chip erase and returns without waiting for it to complete
+*
+* Use sst25vf_IsBusy() to find out when the device is done. Other devices can be accessed in the
+* meantime.
+**/
+void sst25vf_ChipEraseStart(void)
 {
     sst25vf_WREN();
     sst_CE();
-    spiSendByte(EraseCode);
-    SendAddr(Addr);
+    spiBusSendByte(Bus, SST_CHIPERASE);
     sst_nCE();
+    sst_WriteIssued();
+}
+
+//--------------------------------------------------------------------------------------------------
+/**
+* \brief Suspends the erase running on the current device
+* \retval RES_OK The device is ready for reads
+* \retval RES_FAIL The device does not support suspend
+*
+* Returns once the suspend latency has passed. Only reads may be issued until
+* sst25vf_EraseResume() is called.
+**/
+RES_t sst25vf_EraseSuspend(void)
+{
+    const sst25vf_info_t *info = DevInfo[CurrentDevice];
+
+    if (!info || !(info->flags & SST_CAP_SUSPEND))
+    {
+        return(RES_FAIL);
+    }
+    sst25vf_CMD(SST_SUSPEND);
+    sst25vf_StallBusy();
+    return(RES_OK);
+}
+
+//--------------------------------------------------------------------------------------------------
+/**
+* \brief Resumes an erase suspended by sst25vf_EraseSuspend()
+**/
+void sst25vf_EraseResume(void)
+{
+    sst25vf_CMD(SST_RESUME);
+}
+
+//--------------------------------------------------------------------------------------------------
+void sst25vf_xErase(uint32_t Addr, uint8_t EraseCode)
+{
+    sst25vf_xEraseStart(Addr, EraseCode);
     sst25vf_StallBusy();
 }
 
+//--------------------------------------------------------------------------------------------------
+void sst25vf_xEraseStart(uint32_t Addr, uint8_t EraseCode)
+{
+    sst25vf_WREN();
+    sst_CE();
+    SendCmdAddr(EraseCode, Addr);
+    sst_nCE();
+    sst_WriteIssued();
+}
+
+//--------------------------------------------------------------------------------------------------
+/**
+* \brief Erases a block of the current device using the opcode from its capability table
+* \param [in] Addr Address within the block
+* \param [in] size Block size: 0x1000, 0x8000 or 0x10000
+* \retval RES_OK
+* \retval RES_PARAMERR The device does not support erasing blocks of this size
+**/
+RES_t sst25vf_EraseBlock(uint32_t Addr, uint32_t size)
+{
+    const sst25vf_info_t *info = DevInfo[CurrentDevice];
+    uint8_t type = eraseType(size);
+
+    if ((info == 0) || (type >= SST_ETYPE_COUNT) || (info->eraseCmd[type] == 0))
+    {
+        return(RES_PARAMERR);
+    }
+    sst25vf_xErase(Addr, info->eraseCmd[type]);
+    return(RES_OK);
+}
+
+//--------------------------------------------------------------------------------------------------
+/**
+* \brief Checks whether an area of the current device is erased
+* \return 1 if every byte is 0xFF
+*
+* The area is read in one CE window that is ended at the first programmed byte.
+**/
+uint8_t sst25vf_IsBlank(uint32_t Addr, uint32_t size)
+{
+    uint8_t buf[16];
+    uint8_t i;
+    uint8_t n;
+    uint8_t blank;
+
+    sst_CE();
+    spiBusSendFrame(Bus, buf, makeReadHeader(buf, Addr));
+    blank = 1;
+    while (size && blank)
+    {
+        n = (size > sizeof(buf)) ? sizeof(buf) : size;
+        spiBusReadFrame(Bus, buf, n);
+        for (i = 0; i < n; i++)
+        {
+            if (buf[i] != 0xFF)
+            {
+                blank = 0;
+                break;
+            }
+        }
+        size -= n;
+    }
+    sst_nCE();
+    return(blank);
+}
+
+//--------------------------------------------------------------------------------------------------
+/**
+* \brief Erases a block unless it is already blank
+* \retval RES_OK The block is blank
+* \retval RES_PARAMERR See sst25vf_EraseBlock()
+*
+* A blank check of a 4K block takes a few ms at full clock, a fraction of a block erase. A block
+* that is not blank is normally detected within its first bytes.
+**/
+RES_t sst25vf_EraseBlockIfDirty(uint32_t Addr, uint32_t size)
+{
+    const sst25vf_info_t *info = DevInfo[CurrentDevice];
+    uint8_t type = eraseType(size);
+
+    if ((info == 0) || (type >= SST_ETYPE_COUNT) || (info->eraseCmd[type] == 0))
+    {
+        return(RES_PARAMERR);
+    }
+    if (!sst25vf_IsBlank(Addr & ~(size - 1), size))
+    {
+        sst25vf_xErase(Addr, info->eraseCmd[type]);
+    }
+    return(RES_OK);
+}
+
+//--------------------------------------------------------------------------------------------------
+/**
+* \brief Reads the JEDEC Serial Flash Discoverable Parameters
+*
+* Devices without SFDP leave SO floating, which normally reads as 0xFF.
+**/
+void sst25vf_ReadSFDP(uint32_t Addr, uint8_t *data, uint16_t nBytes)
+{
+    uint8_t buf[5];
+    buf[0] = SST_SFDP;
+    buf[1] = (Addr & 0xFF0000) >> 16;
+    buf[2] = (Addr & 0xFF00) >> 8;
+    buf[3] = Addr & 0xFF;
+    buf[4] = DUMMY_CHAR;
+
+    sst_CE();
+    spiBusSendFrame(Bus, buf, 5);
+    spiBusReadFrame(Bus, data, nBytes);
+    sst_nCE();
+}
+
 //--------------------------------------------------------------------------------------------------
 uint16_t sst25vf_RDID()
 {
     uint16_t result;
     sst_CE();
-    spiSendByte(SST_RDID);
-    spiSendByte(0x00);
-    spiSendByte(0x00);
-    spiSendByte(0x00);
-    result = spiGetByte();
+    spiBusSendByte(Bus, SST_RDID);
+    spiBusSendByte(Bus, 0x00);
+    spiBusSendByte(Bus, 0x00);
+    spiBusSendByte(Bus, 0x00);
+    result = spiBusGetByte(Bus);
     result <<= 8;
-    result |= spiGetByte();
+    result |= spiBusGetByte(Bus);
     sst_nCE();
 
     return(result);
@@ -366,14 +2002,96 @@ uint32_t sst25vf_JEDECID()
 {
     uint32_t result;
     sst_CE();
-    spiSendByte(SST_JEDECID);
-    result = spiGetByte();
+    spiBusSendByte(Bus, SST_JEDECID);
+    result = spiBusGetByte(Bus);
     result <<= 8;
-    result |= spiGetByte();
+    result |= spiBusGetByte(Bus);
     result <<= 8;
-    result |= spiGetByte();
+    result |= spiBusGetByte(Bus);
     sst_nCE();
     return(result);
 }
 
+#if SST_USE_SPI_QUEUE
+//--------------------------------------------------------------------------------------------------
+RES_t sst25vf_ReadAsync(uint32_t startAddr, uint8_t *data, uint16_t nBytes,
+                        spiTransactionCallback_t callback, void *context)
+{
+    spiTransaction_t *q[2];
+    spiTransaction_t *t;
+    uint8_t poll = queueNeedsPoll();
+
+    if (!queueAlloc(q, poll + 1))
+    {
+        return(RES_FULL);
+    }
+    if (poll)
+    {
+        makePoll(q[0]);
+        spiQueueSubmit(q[0]);
+        DevQueueReady[CurrentDevice] = 1;
+    }
+
+    t = q[poll];
+    t->bus = Bus;
+    t->target = CurrentDevice;
+    t->headerLen = makeReadHeader(t->header, startAddr);
+    t->dir = SPIQ_DIR_READ;
+    t->pData = data;
+    t->dataLen = nBytes;
+    t->callback = callback;
+    t->context = context;
+    spiQueueSubmit(t);
+    return(RES_OK);
+}
+
+//--------------------------------------------------------------------------------------------------
+RES_t sst25vf_xEraseAsync(uint32_t Addr, uint8_t EraseCode,
+                        spiTransactionCallback_t callback, void *context)
+{
+    spiTransaction_t *q[4];
+    spiTransaction_t *wren;
+    spiTransaction_t *t;
+    spiTransaction_t *done;
+    uint8_t poll = queueNeedsPoll();
+
+    // [poll,] WREN, erase, poll
+    if (!queueAlloc(q, poll + 3))
+    {
+        return(RES_FULL);
+    }
+    if (poll)
+    {
+        makePoll(q[0]);
+        spiQueueSubmit(q[0]);
+    }
+    wren = q[poll];
+    t = q[poll + 1];
+    done = q[poll + 2];
+
+    wren->bus = Bus;
+    wren->target = CurrentDevice;
+    wren->header[0] = SST_WREN;
+    wren->headerLen = 1;
+
+    t->bus = Bus;
+    t->target = CurrentDevice;
+    t->header[0] = EraseCode;
+    putAddr(&t->header[1], Addr);
+    t->headerLen = 4;
+
+    // The callback comes with the poll that sees the erase finish
+    makePoll(done);
+    done->callback = callback;
+    done->context = context;
+
+    spiQueueSubmit(wren);
+    spiQueueSubmit(t);
+    spiQueueSubmit(done);
+    sst_WriteIssued();
+    DevQueueReady[CurrentDevice] = 1;
+    return(RES_OK);
+}
+#endif
+
 ///\}
@@ -51,7 +51,11 @@ extern "C" {
 
 
 #include <stdint.h>
+#include "result.h"
 #include "SST25VF_config.h"
+#if SST_USE_SPI_QUEUE
+#include "spi_queue.h"
+#endif
 
 //==================================================================================================
 // Constant Definitions
@@ -72,6 +76,7 @@ extern "C" {
 /// \name Commands
 ///\{
 #define SST_RD          0x03
+#define SST_HSRD        0x0B
 #define SST_ERASE4k     0x20
 #define SST_ERASE32k    0x52
 #define SST_ERASE64k    0xD8
@@ -87,6 +92,9 @@ extern "C" {
 #define SST_JEDECID     0x9F
 #define SST_EBSY        0x70
 #define SST_DBSY        0x80
+#define SST_SFDP        0x5A
+#define SST_SUSPEND     0x75
+#define SST_RESUME      0x7A
 ///\}
 
 /// \name Device IDs
@@ -107,6 +115,8 @@ extern "C" {
 #define SST25VF080_JEDEC    0x00BF258EL
 #define SST25VF016_JEDEC    0x00BF2541L
 #define SST25VF032_JEDEC    0x00BF254AL
+
+#define MX25R1035F_JEDEC    0x00C22811L
 ///\}
 
 /// \name Device Sizes
@@ -118,6 +128,68 @@ extern "C" {
 #define SST25VF016_SIZE     0x00200000L
 #define SST25VF032_SIZE     0x00400000L
 ///\}
+
+/// \name Write Modes
+/// \brief Values of sst25vf_info_t::writeMode
+///\{
+#define SST_WRITE_BYTE      0   ///< One byte per program cycle
+#define SST_WRITE_AAI       1   ///< SST Auto Address Increment word programming
+#define SST_WRITE_PAGE      2   ///< Page program (#SST_WRBYTE with up to a page of data)
+///\}
+
+/// \name Erase Types
+/// \brief Indexes of sst25vf_info_t::eraseCmd and sst25vf_info_t::eraseTimeMs
+///\{
+#define SST_ETYPE_4K        0   ///< 4 KB block
+#define SST_ETYPE_32K       1   ///< 32 KB block
+#define SST_ETYPE_64K       2   ///< 64 KB block
+#define SST_ETYPE_COUNT     3
+///\}
+
+/// \name Capability Flags
+/// \brief Bits of sst25vf_info_t::flags
+///\{
+#define SST_CAP_EWSR        0x01    ///< WRSR is enabled by #SST_EWSR rather than #SST_WREN
+#define SST_CAP_EBSY        0x02    ///< Hardware end-of-write detection (#SST_EBSY)
+#define SST_CAP_SUSPEND     0x04    ///< Program/erase suspend and resume
+///\}
+
+//==================================================================================================
+// Types
+//==================================================================================================
+
+    ///\brief Capabilities of a supported device
+    typedef struct
+    {
+        uint16_t id;            ///< RDID result
+        uint32_t jedec;         ///< JEDEC ID
+        uint32_t size;          ///< Size in bytes
+        uint8_t eraseCmd[SST_ETYPE_COUNT]; ///< Erase opcode of each erase type. 0 = not supported
+        uint8_t writeMode;      ///< One of the \c SST_WRITE_x modes
+        uint16_t pageSize;      ///< Page size for #SST_WRITE_PAGE
+        uint8_t fastReadCmd;    ///< High-speed read opcode (takes one dummy byte)
+        uint32_t maxClk;        ///< Highest clock for all commands except #SST_RD in Hz
+        uint32_t maxReadClk;    ///< Highest clock for #SST_RD in Hz
+        uint8_t flags;          ///< \c SST_CAP_x flags
+        uint16_t eraseTimeMs[SST_ETYPE_COUNT]; ///< Typical erase time of each erase type in ms
+        uint16_t chipEraseMs;   ///< Typical chip erase time in ms
+        uint16_t progTimeUs;    ///< Typical time of one program cycle (byte, word or page) in us
+    } sst25vf_info_t;
+
+#if SST_CACHE_STATUS
+    ///\brief Number of transactions left out because the device state was already known
+    typedef struct
+    {
+        uint32_t WREN;          ///< WEL was already set
+        uint32_t WRSR;          ///< Status register already held the value (saves EWSR/WREN, WRSR and RDSR)
+        uint32_t RDSR;          ///< Busy polls of a device known to be idle
+        uint32_t EBSY;          ///< EBSY was already enabled
+        uint32_t DBSY;          ///< EBSY was already disabled, or did not need to be
+    } sst25vf_elided_t;
+
+    ///\brief Elision counters. May be cleared by the application at any time.
+    extern sst25vf_elided_t sst25vf_Elided;
+#endif
 //==================================================================================================
 // Function Prototypes
 //==================================================================================================
@@ -129,15 +201,21 @@ extern "C" {
 
     ///\cond PRIVATE
     void sst25vf_xErase(uint32_t Addr, uint8_t EraseCode);
+    void sst25vf_xEraseStart(uint32_t Addr, uint8_t EraseCode);
     ///\endcond
 
     void sst25vf_SetCurrentDevice(uint8_t device);
     uint8_t sst25vf_GetCurrentDevice(void);
+#if SST_CE_MODE == 0
+    RES_t sst25vf_SetBroadcast(uint16_t devices);
+#endif
 
     uint16_t sst25vf_Init(void);
+    const sst25vf_info_t* sst25vf_GetInfo(void);
     uint8_t sst25vf_RDSR(void);
     void sst25vf_WRSR(uint8_t status);
     void sst25vf_StallBusy(void);
+    uint8_t sst25vf_IsBusy(void);
     void sst25vf_CMD(uint8_t data);
 #define sst25vf_WREN()            sst25vf_CMD(SST_WREN)
 #define sst25vf_WRDI()            sst25vf_CMD(SST_WRDI)
@@ -145,12 +223,29 @@ extern "C" {
 #define sst25vf_EBSY()            sst25vf_CMD(SST_EBSY)
 #define sst25vf_DBSY()            sst25vf_CMD(SST_DBSY)
     void sst25vf_ChipErase(void);
-    void sst25vf_Read(uint32_t startAddr, uint8_t *data, uint16_t nBytes);
+    void sst25vf_ChipEraseStart(void);
+    RES_t sst25vf_EraseSuspend(void);
+    void sst25vf_EraseResume(void);
+    RES_t sst25vf_EraseBlock(uint32_t Addr, uint32_t size);
+    RES_t sst25vf_EraseBlockIfDirty(uint32_t Addr, uint32_t size);
+    uint8_t sst25vf_IsBlank(uint32_t Addr, uint32_t size);
+    void sst25vf_ReadSFDP(uint32_t Addr, uint8_t *data, uint16_t nBytes);
+    void sst25vf_Read(uint32_t startAddr, uint8_t *data, uint32_t nBytes);
+    void sst25vf_ReadStart(uint32_t startAddr, uint8_t *data, uint16_t nBytes);
+    void sst25vf_Sync(void);
     void sst25vf_WriteByte(uint32_t startAddr, const uint8_t data);
     void sst25vf_Write(uint32_t startAddr, const uint8_t *data, uint16_t nBytes);
     void sst25vf_WriteSlow(uint32_t startAddr, const uint8_t *data, uint16_t nBytes);
+    void sst25vf_ReadBegin(uint32_t startAddr);
+    void sst25vf_ReadCont(uint8_t *data, uint16_t nBytes);
+    void sst25vf_ReadEnd(void);
+    void sst25vf_WriteBegin(uint32_t startAddr);
+    void sst25vf_WriteCont(const uint8_t *data, uint16_t nBytes);
+    void sst25vf_WriteEnd(void);
     void sst25vf_AAIStart(uint32_t startAddr, const uint8_t D0, const uint8_t D1);
     void sst25vf_AAICont(const uint8_t D0, const uint8_t D1);
+    uint16_t sst25vf_ProgramStart(uint32_t startAddr, const uint8_t *data, uint16_t nBytes);
+    void sst25vf_ProgramFinish(void);
 #define sst25vf_4kErase(A)        sst25vf_xErase((A),SST_ERASE4k)
 #define sst25vf_32kErase(A)        sst25vf_xErase((A),SST_ERASE32k)
 #define sst25vf_64kErase(A)        sst25vf_xErase((A),SST_ERASE64k)
@@ -158,6 +253,23 @@ extern "C" {
     uint32_t sst25vf_JEDECID();
 ///\}
 
+#if SST_USE_SPI_QUEUE
+///\name Asynchronous Functions
+///\brief Functions that queue their transactions on the \ref MOD_SPIQUEUE "SPI Transaction Queue"
+/// for the current device and return immediately. \c callback is called from an ISR once the
+/// last transaction has completed. \n
+/// A command that may find the device busy is queued behind a status poll (#SPIQ_DIR_POLL), so a
+/// read or erase takes up to two or four descriptors. An erase completes, and its callback is
+/// called, when the device reports ready again, not when the command is sent. RES_FULL is
+/// returned if the pool has too few descriptors left; nothing is queued then.
+///\{
+    RES_t sst25vf_ReadAsync(uint32_t startAddr, uint8_t *data, uint16_t nBytes,
+                            spiTransactionCallback_t callback, void *context);
+    RES_t sst25vf_xEraseAsync(uint32_t Addr, uint8_t EraseCode,
+                            spiTransactionCallback_t callback, void *context);
+///\}
+#endif
+
 #ifdef __cplusplus
 }
 #endif
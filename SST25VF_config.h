@@ -25,11 +25,88 @@
 
 /// Chip Enable Mode
 #define SST_CE_MODE         0       ///< \hideinitializer
-/**<    0 = One-hot mode: Each chip's CE line is directly connected to a port \n
-*       1 = Addressed chip mode: Array of chips is addressed using 74x138, 74x154 or similar
+/**<    0 = One-hot mode: Each chip's CE line is directly connected to a port. Up to 16 chips:
+*           0-7 on #SST_CE_POUT, 8-15 on #SST_CE_POUT1. \n
+*       1 = Addressed chip mode: Array of chips is addressed using 74x138, 74x154 or similar.
+*           Up to 2^#SST_ADDR_WIDTH chips, all on #SPI_BUS_DEFAULT.
 **/
 
 
+/// Use the \ref MOD_SPIQUEUE "SPI Transaction Queue" as transport for the asynchronous functions
+#define SST_USE_SPI_QUEUE   1       ///< \hideinitializer
+/**<    0 = Asynchronous functions are not available \n
+*       1 = sst25vf_ReadAsync() and sst25vf_xEraseAsync() queue their transactions. Synchronous
+*           functions wait until the queue has drained before accessing the bus.
+**/
+
+/// Use High-Speed Read when the bus is faster than the device's limit for #SST_RD
+#define SST_FAST_READ       1       ///< \hideinitializer
+/**<    0 = Bus profiles are limited to the #SST_RD clock and reads always use #SST_RD \n
+*       1 = Bus profiles use the highest clock the device supports. Reads use #SST_HSRD (with its
+*           dummy byte) on devices whose profile exceeds the #SST_RD limit.
+**/
+
+/// End-of-write detection during AAI programming
+#define SST_EOW_MODE        1       ///< \hideinitializer
+/**<    0 = Poll the BUSY bit with RDSR after every word \n
+*       1 = Hardware end-of-write: EBSY makes SO output RY/BY#. The CE of the next command is
+*           asserted and the SOMI pin is sampled until the device is ready, then the command is
+*           clocked in the same CE window. \n
+*       2 = Like 1, but the CPU waits in LPM0 for a rising edge on #SST_RYBY_BIT. SO must also be
+*           wired to that P1/P2 pin, which must be an input. The module then owns #SST_RYBY_VECTOR.
+*           Host builds treat this as 1.
+**/
+
+/// \name RY/BY# interrupt pin (SST_EOW_MODE == 2)
+///\{
+#define SST_RYBY_BIT        BIT0            ///< \hideinitializer
+#define SST_RYBY_PIN        P2IN            ///< \hideinitializer
+#define SST_RYBY_PIE        P2IE            ///< \hideinitializer
+#define SST_RYBY_PIES       P2IES           ///< \hideinitializer
+#define SST_RYBY_PIFG       P2IFG           ///< \hideinitializer
+#define SST_RYBY_VECTOR     PORT2_VECTOR    ///< \hideinitializer
+///\}
+
+/// Discover device geometry from the JEDEC SFDP table
+#define SST_USE_SFDP        1       ///< \hideinitializer
+/**<    0 = Only devices in the built-in table are supported \n
+*       1 = sst25vf_Init() reads the SFDP Basic Flash Parameter Table (#SST_SFDP) if the device has
+*           one. Size, erase opcodes, page size and typical timings are taken from it, and devices
+*           that are not in the built-in table are accepted. Costs one sst25vf_info_t of RAM per
+*           device.
+**/
+
+/// Clock limit for devices that are only known from SFDP (SFDP does not describe clock limits)
+#define SST_SFDP_MAX_CLK    25000000L   ///< \hideinitializer
+
+/// Track the state of each device to leave out redundant transactions
+#define SST_CACHE_STATUS    1       ///< \hideinitializer
+/**<    0 = Every command is sent as requested \n
+*       1 = The status register, WEL, EBSY and whether a write or erase may be in progress are
+*           tracked per device. WREN, WRSR, EBSY and DBSY that would not change anything and busy
+*           polls of idle devices are left out and counted in #sst25vf_Elided. The device must
+*           only be accessed through this module.
+**/
+
+/// Skip bytes that would not change the array when writing
+#define SST_WRITE_SKIP      1       ///< \hideinitializer
+/**<    0 = sst25vf_Write() programs every byte \n
+*       1 = Bytes of 0xFF are skipped. Programming can only clear bits, so they are no-ops. \n
+*       2 = Like 1, and the area is read first. Bytes whose programming would not clear any bit
+*           (e.g. because they already hold the data) are skipped too. Costs #SST_SKIP_WINDOW bytes
+*           of RAM and one read of the area per write.
+*
+*       AAI and byte writes are split around runs of at least #SST_SKIP_MIN_GAP skippable bytes.
+*       Page writes only trim skippable bytes at the ends of each page and skip pages that have
+*       nothing to program, since every page program takes the same time.
+**/
+
+/// Shortest run of skippable bytes that ends an AAI or byte write sequence
+#define SST_SKIP_MIN_GAP    4       ///< \hideinitializer
+
+/// Size of the read-back window for #SST_WRITE_SKIP == 2 in bytes
+#define SST_SKIP_WINDOW     32      ///< \hideinitializer
+
 //--------------------------------------------------------------------------------------------------
 // One-hot CE mode (SST_CE_MODE == 0)
 //--------------------------------------------------------------------------------------------------
@@ -42,10 +119,45 @@
 #define SST_CE_DEV5_BIT     0    // disabled
 #define SST_CE_DEV6_BIT     0    // disabled
 #define SST_CE_DEV7_BIT     0    // disabled
+#define SST_CE_DEV8_BIT     0    // disabled
+#define SST_CE_DEV9_BIT     0    // disabled
+#define SST_CE_DEV10_BIT    0    // disabled
+#define SST_CE_DEV11_BIT    0    // disabled
+#define SST_CE_DEV12_BIT    0    // disabled
+#define SST_CE_DEV13_BIT    0    // disabled
+#define SST_CE_DEV14_BIT    0    // disabled
+#define SST_CE_DEV15_BIT    0    // disabled
 
-/// CE output port where the CE pins are located
+/// CE output port where the CE pins of devices 0-7 are located
 #define SST_CE_POUT         P4OUT
 
+/// CE direction register where the CE pins of devices 0-7 are located
+#define SST_CE_PDIR         P4DIR
+
+/// CE output port where the CE pins of devices 8-15 are located. Unused if they are all disabled.
+#define SST_CE_POUT1        P6OUT
+
+/// CE direction register where the CE pins of devices 8-15 are located
+#define SST_CE_PDIR1        P6DIR
+
+// SPI bus (index in spiBus) each SST chip is connected to
+#define SST_DEV0_BUS        0
+#define SST_DEV1_BUS        0
+#define SST_DEV2_BUS        0
+#define SST_DEV3_BUS        0
+#define SST_DEV4_BUS        0
+#define SST_DEV5_BUS        0
+#define SST_DEV6_BUS        0
+#define SST_DEV7_BUS        0
+#define SST_DEV8_BUS        0
+#define SST_DEV9_BUS        0
+#define SST_DEV10_BUS       0
+#define SST_DEV11_BUS       0
+#define SST_DEV12_BUS       0
+#define SST_DEV13_BUS       0
+#define SST_DEV14_BUS       0
+#define SST_DEV15_BUS       0
+
 //--------------------------------------------------------------------------------------------------
 // Addressed CE Mode (SST_CE_MODE == 1)
 //--------------------------------------------------------------------------------------------------
@@ -58,7 +170,7 @@
 /// Output port where address lines are connected (LSb of address must start at LSb of port)
 #define SST_ADDR_POUT       P1OUT   ///< \hideinitializer
 
-/// Bit width of the address lines
+/// Bit width of the address lines (2 to 8). A 74x154 needs 4 for 16 chips.
 #define SST_ADDR_WIDTH      2       ///< \hideinitializer
 
 ///\}
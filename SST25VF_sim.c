@@ -0,0 +1,712 @@
+/*
+* Copyright (c) 2012, Alexander I. Mykyta
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+* ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/**
+* \addtogroup MOD_SST25VF_SIM
+* \{
+**/
+
+/**
+* \file
+* \brief Code for \ref MOD_SST25VF_SIM "SST25VF Serial Flash Simulator"
+**/
+
+#ifndef __MSP430__
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "SST25VF_sim.h"
+
+//==================================================================================================
+// Internal Functions
+//==================================================================================================
+///\cond INTERNAL
+
+// Status register bits (same positions for both families)
+#define SR_BUSY     0x01
+#define SR_WEL      0x02
+#define SR_AAI      0x40
+
+#define FAMILY_SST  0   // SST25VF: AAI, EWSR, EBSY
+#define FAMILY_STD  1   // Standard command set: page program, WRSR after WREN
+
+#define US          1000ULL
+#define MS          1000000ULL
+
+// Erase suspend latency (MX25R tESL, W25Q tSUS)
+#define SUSPEND_NS      (20*US)
+
+// Number of error messages printed before going quiet
+#define MAX_ERROR_MSGS  10
+
+typedef struct
+{
+    const char *name;
+    uint8_t family;
+    uint16_t rdid;          // RDID (0x90) result: manufacturer << 8 | device
+    uint32_t jedec;         // JEDEC ID (0x9F)
+    uint32_t size;          // bytes
+    uint8_t srPowerUp;      // status register after power-up
+    uint8_t srWritable;     // status bits that WRSR can change
+    uint32_t maxClk;        // highest clock for all commands except SST_RD, Hz
+    uint32_t maxReadClk;    // highest clock for 0x03, Hz
+    // Typical operation times in ns
+    uint64_t tProg;         // byte (SST) / AAI word (SST) / page program
+    uint64_t tSE;           // 4K erase
+    uint64_t tBE32;         // 32K erase
+    uint64_t tBE64;         // 64K erase
+    uint64_t tCE;           // chip erase
+    uint64_t tW;            // write status register
+    const uint8_t *sfdp;    // SFDP area or NULL if the device does not support SST_SFDP
+    uint8_t sfdpLen;
+} simChip_t;
+
+#define DW(x)   ((x) & 0xFF), (((x) >> 8) & 0xFF), (((x) >> 16) & 0xFF), (((x) >> 24) & 0xFF)
+
+// MX25R1035F SFDP: header, one parameter header and a 16-DWORD Basic Flash Parameter Table (JESD216B)
+static const uint8_t MX25R_SFDP[] =
+{
+    'S', 'F', 'D', 'P', 0x06, 0x01, 0x00, 0xFF,
+    0x00, 0x06, 0x01, 0x10, 0x10, 0x00, 0x00, 0xFF,
+    DW(0xFFF120E5UL),   // 3-byte addresses, 4K erase 0x20, page >= 64 bytes
+    DW(0x000FFFFFUL),   // 1 Mbit
+    DW(0x6B08EB44UL), DW(0xBB043B08UL), DW(0xFFFFFFFEUL), DW(0xFF00FFFFUL), DW(0xFF00FFFFUL),
+    DW(0x520F200CUL),   // 4K/0x20, 32K/0x52
+    DW(0x0000D810UL),   // 64K/0xD8
+    DW(0x00E16223UL),   // erase times: 48 ms, 208 ms, 400 ms
+    DW(0x24002C81UL),   // 256 byte pages, program 832 us, chip erase 1280 ms
+    DW(0x3C9CE4BBUL),   // suspend/resume supported
+    DW(0x757A7A75UL), DW(0x5CD5BDF7UL), DW(0x00FF5040UL), DW(0xFFFFFFFFUL)
+};
+
+// W25Q16JV SFDP. The device is not in the driver's table, so it can only be used through SFDP.
+static const uint8_t W25Q_SFDP[] =
+{
+    'S', 'F', 'D', 'P', 0x06, 0x01, 0x00, 0xFF,
+    0x00, 0x06, 0x01, 0x10, 0x10, 0x00, 0x00, 0xFF,
+    DW(0xFFF920E5UL),   // 3-byte addresses, 4K erase 0x20, page >= 64 bytes
+    DW(0x00FFFFFFUL),   // 16 Mbit
+    DW(0x6B08EB44UL), DW(0xBB423B08UL), DW(0xFFFFFFFEUL), DW(0xFF00FFFFUL), DW(0xEB40FFFFUL),
+    DW(0x520F200CUL),   // 4K/0x20, 32K/0x52
+    DW(0x0000D810UL),   // 64K/0xD8
+    DW(0x00A53A23UL),   // erase times: 48 ms, 128 ms, 160 ms
+    DW(0x33002581UL),   // 256 byte pages, program 384 us, chip erase 5120 ms
+    DW(0x2D00E6ECUL),   // suspend/resume supported
+    DW(0x7A757A75UL), DW(0x5CD5BDF7UL), DW(0x00FF5040UL), DW(0xFFFFFFFFUL)
+};
+
+// Generic 16 Mbit part known only from SFDP, with the W25Q16JV table except DWORD 11, which
+// also gives byte program times. That sets bit 14, right above the 1-bit page program time unit.
+static const uint8_t SFDP16M_SFDP[] =
+{
+    'S', 'F', 'D', 'P', 0x06, 0x01, 0x00, 0xFF,
+    0x00, 0x06, 0x01, 0x10, 0x10, 0x00, 0x00, 0xFF,
+    DW(0xFFF920E5UL),   // 3-byte addresses, 4K erase 0x20, page >= 64 bytes
+    DW(0x00FFFFFFUL),   // 16 Mbit
+    DW(0x6B08EB44UL), DW(0xBB423B08UL), DW(0xFFFFFFFEUL), DW(0xFF00FFFFUL), DW(0xEB40FFFFUL),
+    DW(0x520F200CUL),   // 4K/0x20, 32K/0x52
+    DW(0x0000D810UL),   // 64K/0xD8
+    DW(0x00A53A23UL),   // erase times: 48 ms, 128 ms, 160 ms
+    DW(0x3309E581UL),   // 256 byte pages, program 384 us, byte 8 us + 2 us, chip erase 5120 ms
+    DW(0x2D00E6ECUL),   // suspend/resume supported
+    DW(0x7A757A75UL), DW(0x5CD5BDF7UL), DW(0x00FF5040UL), DW(0xFFFFFFFFUL)
+};
+
+// Timing from datasheet typicals. SST: SST25VFxxxB datasheets. MX25R: MX25R1035F, ultra low power
+// mode (the power-up default). W25Q: W25Q16JV.
+static const simChip_t CHIPS[SIM_TYPE_COUNT] =
+{
+    {"SST25VF040B", FAMILY_SST, 0xBF8D, 0xBF258DL, 0x080000L, 0x1C, 0xBC, 50000000L, 25000000L,
+        7*US, 18*MS, 18*MS, 18*MS, 35*MS, 0, NULL, 0},
+    {"SST25VF080B", FAMILY_SST, 0xBF8E, 0xBF258EL, 0x100000L, 0x1C, 0xBC, 50000000L, 25000000L,
+        7*US, 18*MS, 18*MS, 18*MS, 35*MS, 0, NULL, 0},
+    {"SST25VF016B", FAMILY_SST, 0xBF41, 0xBF2541L, 0x200000L, 0x1C, 0xBC, 50000000L, 25000000L,
+        7*US, 18*MS, 18*MS, 18*MS, 35*MS, 0, NULL, 0},
+    {"SST25VF032B", FAMILY_SST, 0xBF4A, 0xBF254AL, 0x400000L, 0x3C, 0xBC, 66000000L, 25000000L,
+        7*US, 18*MS, 18*MS, 18*MS, 35*MS, 0, NULL, 0},
+    {"MX25R1035F",  FAMILY_STD, 0xC211, 0xC22811L, 0x020000L, 0x00, 0xFC, 33000000L, 33000000L,
+        850*US, 40*MS, 200*MS, 400*MS, 1200*MS, 10*MS, MX25R_SFDP, sizeof(MX25R_SFDP)},
+    {"W25Q16JV",    FAMILY_STD, 0xEF14, 0xEF4015L, 0x200000L, 0x00, 0xFC, 133000000L, 50000000L,
+        400*US, 45*MS, 120*MS, 150*MS, 5000*MS, 10*MS, W25Q_SFDP, sizeof(W25Q_SFDP)},
+    {"SFDP16M",     FAMILY_STD, 0x8514, 0x856015L, 0x200000L, 0x00, 0xFC, 104000000L, 50000000L,
+        384*US, 45*MS, 120*MS, 150*MS, 5000*MS, 10*MS, SFDP16M_SFDP, sizeof(SFDP16M_SFDP)},
+};
+
+typedef struct
+{
+    const simChip_t *chip;
+    uint16_t ce;            // CE mask (see sstSim_AddDevice())
+    uint8_t bus;
+    uint8_t *mem;
+
+    uint8_t sr;             // status register without BUSY
+    uint8_t ewsr;           // EWSR latched for the next command
+    uint8_t ebsy;           // SO outputs RY/BY# during AAI
+    uint8_t aai;            // in AAI mode
+    uint32_t aaiAddr;
+    uint64_t busyUntil;
+    uint8_t clearWel;       // clear WEL once the current operation completes
+    uint8_t erasing;        // the current operation is an erase
+    uint8_t suspended;      // an erase is suspended
+    uint64_t suspendRemain; // time left of the suspended erase
+
+    // Current transaction
+    uint8_t selected;
+    uint8_t ignore;         // command rejected; do not execute at CE release
+    uint32_t count;         // bytes clocked since CE assertion
+    uint8_t cmd;
+    uint32_t addr;
+    uint16_t dataLen;
+    uint8_t data[256];
+} simDev_t;
+
+static simDev_t Devs[SIM_MAX_DEVICES];
+static uint8_t DevCount;
+static uint64_t Now;
+static sstSimStats_t Stats;
+
+//--------------------------------------------------------------------------------------------------
+static void simError(simDev_t *d, const char *msg)
+{
+    Stats.errors++;
+    if (Stats.errors <= MAX_ERROR_MSGS)
+    {
+        fprintf(stderr, "sim: %s (CE 0x%04X) cmd 0x%02X: %s\n", d->chip->name, d->ce, d->cmd, msg);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+static uint8_t isBusy(simDev_t *d)
+{
+    if (Now < d->busyUntil)
+    {
+        return(1);
+    }
+    if (d->clearWel)
+    {
+        d->sr &= ~SR_WEL;
+        d->clearWel = 0;
+    }
+    return(0);
+}
+
+//--------------------------------------------------------------------------------------------------
+static void startBusy(simDev_t *d, uint64_t ns, uint8_t clearWel)
+{
+    d->busyUntil = Now + ns;
+    d->clearWel = clearWel;
+    d->erasing = 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+static uint8_t isProtected(simDev_t *d)
+{
+    // Simplified: any block protection bit protects the whole array
+    return((d->sr & 0x3C) ? 1 : 0);
+}
+
+//--------------------------------------------------------------------------------------------------
+static uint8_t needWel(simDev_t *d)
+{
+    if ((d->sr & SR_WEL) == 0)
+    {
+        simError(d, "write without WEL");
+        return(0);
+    }
+    if (isProtected(d))
+    {
+        simError(d, "write to protected array");
+        return(0);
+    }
+    return(1);
+}
+
+//--------------------------------------------------------------------------------------------------
+static void program(simDev_t *d, uint32_t addr, uint8_t val)
+{
+    uint8_t *m = &d->mem[addr % d->chip->size];
+    if (val & ~*m)
+    {
+        Stats.bitConflicts++;
+    }
+    *m &= val; // programming can only clear bits
+}
+
+//--------------------------------------------------------------------------------------------------
+static void erase(simDev_t *d, uint32_t size, uint64_t t)
+{
+    uint32_t start = (d->addr % d->chip->size) & ~(size - 1);
+    memset(&d->mem[start], 0xFF, size);
+    startBusy(d, t, 1);
+    d->erasing = 1;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Execute a write-type command at CE release
+static void execute(simDev_t *d)
+{
+    uint8_t ewsr = d->ewsr;
+    uint16_t i;
+
+    d->ewsr = 0;
+
+    if (d->aai && (d->cmd != 0xAD) && (d->cmd != 0x04) && (d->cmd != 0x05))
+    {
+        simError(d, "command not allowed in AAI mode");
+        return;
+    }
+
+    switch (d->cmd)
+    {
+    case 0x03: case 0x0B: case 0x05: case 0x90: case 0xAB: case 0x9F:
+        break; // reads are handled while clocking
+
+    case 0x5A: // SFDP
+        if (d->chip->sfdp == NULL)
+        {
+            Stats.unsupported++;
+        }
+        break;
+
+    case 0x06: // WREN
+        d->sr |= SR_WEL;
+        break;
+
+    case 0x04: // WRDI
+        d->sr &= ~(SR_WEL | SR_AAI);
+        d->aai = 0;
+        break;
+
+    case 0x50: // EWSR
+        if (d->chip->family != FAMILY_SST)
+        {
+            simError(d, "unsupported command");
+            break;
+        }
+        d->ewsr = 1;
+        break;
+
+    case 0x01: // WRSR
+        if (d->count < 2)
+        {
+            simError(d, "WRSR without data");
+            break;
+        }
+        if (!(d->sr & SR_WEL) && !((d->chip->family == FAMILY_SST) && ewsr))
+        {
+            simError(d, "WRSR not enabled");
+            break;
+        }
+        d->sr = (d->sr & ~d->chip->srWritable) | (d->data[0] & d->chip->srWritable);
+        if (d->chip->tW)
+        {
+            startBusy(d, d->chip->tW, 1);
+        }
+        else
+        {
+            d->sr &= ~SR_WEL;
+        }
+        break;
+
+    case 0x70: // EBSY
+    case 0x80: // DBSY
+        if (d->chip->family != FAMILY_SST)
+        {
+            simError(d, "unsupported command");
+            break;
+        }
+        d->ebsy = (d->cmd == 0x70);
+        break;
+
+    case 0x02: // Byte program (SST) / page program (MX)
+        if ((d->count < 5) || !needWel(d))
+        {
+            if (d->count < 5) simError(d, "program without data");
+            break;
+        }
+        if (d->chip->family == FAMILY_SST)
+        {
+            program(d, d->addr, d->data[0]);
+        }
+        else
+        {
+            // Page program wraps within the 256 byte page. Only the last 256 bytes are kept.
+            for (i = 0; i < d->dataLen; i++)
+            {
+                program(d, (d->addr & ~0xFFUL) | ((d->addr + i) & 0xFF), d->data[i]);
+            }
+        }
+        startBusy(d, d->chip->tProg, 1);
+        break;
+
+    case 0xAD: // AAI word program
+        if (d->chip->family != FAMILY_SST)
+        {
+            simError(d, "unsupported command");
+            break;
+        }
+        if (!d->aai)
+        {
+            if ((d->count != 6) || !needWel(d))
+            {
+                if (d->count != 6) simError(d, "bad AAI start length");
+                break;
+            }
+            d->aaiAddr = d->addr & ~1UL;
+            d->aai = 1;
+            d->sr |= SR_AAI;
+        }
+        else if (d->count != 3)
+        {
+            simError(d, "bad AAI continue length");
+            break;
+        }
+        program(d, d->aaiAddr, d->data[0]);
+        program(d, d->aaiAddr + 1, d->data[1]);
+        d->aaiAddr += 2;
+        startBusy(d, d->chip->tProg, 0);
+        break;
+
+    case 0x20: // 4K erase
+        if ((d->count == 4) && needWel(d)) erase(d, 0x1000, d->chip->tSE);
+        break;
+    case 0x52: // 32K erase
+        if ((d->count == 4) && needWel(d)) erase(d, 0x8000, d->chip->tBE32);
+        break;
+    case 0xD8: // 64K erase
+        if ((d->count == 4) && needWel(d)) erase(d, 0x10000, d->chip->tBE64);
+        break;
+    case 0x60: // chip erase
+    case 0xC7:
+        if (needWel(d))
+        {
+            d->addr = 0;
+            erase(d, d->chip->size, d->chip->tCE);
+        }
+        break;
+
+    case 0x75: // erase suspend
+        if ((d->chip->family == FAMILY_STD) && d->erasing && isBusy(d) && !d->suspended)
+        {
+            d->suspendRemain = d->busyUntil - Now;
+            d->busyUntil = Now + SUSPEND_NS;
+            d->suspended = 1;
+        }
+        else if (d->chip->family != FAMILY_STD)
+        {
+            Stats.unsupported++;
+        }
+        break;
+    case 0x7A: // erase resume
+        if ((d->chip->family == FAMILY_STD) && d->suspended)
+        {
+            d->busyUntil = Now + d->suspendRemain;
+            d->suspended = 0;
+        }
+        else if (d->chip->family != FAMILY_STD)
+        {
+            Stats.unsupported++;
+        }
+        break;
+
+    default:
+        Stats.unsupported++;
+        break;
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+// Clock one byte into a selected device. Returns the byte it drives on SO.
+static uint8_t clockByte(simDev_t *d, uint8_t mosi, uint32_t sclkHz)
+{
+    uint32_t n = d->count++;
+    uint32_t limit;
+
+    if (n == 0)
+    {
+        d->cmd = mosi;
+        d->addr = 0;
+        d->dataLen = 0;
+        Stats.opcodes[mosi]++;
+
+        if (isBusy(d) && (mosi != 0x05) && !((mosi == 0x75) && d->erasing && !d->suspended))
+        {
+            simError(d, "command while busy");
+            d->ignore = 1;
+        }
+        else if (d->suspended && (mosi != 0x03) && (mosi != 0x0B) && (mosi != 0x05) && (mosi != 0x7A))
+        {
+            simError(d, "command while erase is suspended");
+            d->ignore = 1;
+        }
+
+        limit = (mosi == 0x03) ? d->chip->maxReadClk : d->chip->maxClk;
+        if (sclkHz > limit)
+        {
+            simError(d, "bus clock exceeds device limit");
+        }
+        return(0xFF);
+    }
+
+    if (d->ignore)
+    {
+        return(0xFF);
+    }
+
+    switch (d->cmd)
+    {
+    case 0x05: // RDSR
+        return(d->sr | (isBusy(d) ? SR_BUSY : 0));
+
+    case 0x03: // Read
+    case 0x0B: // High-speed read
+        if (n <= 3)
+        {
+            d->addr = (d->addr << 8) | mosi;
+            return(0xFF);
+        }
+        if ((d->cmd == 0x0B) && (n == 4))
+        {
+            return(0xFF); // dummy byte
+        }
+        return(d->mem[d->addr++ % d->chip->size]);
+
+    case 0x90: // RDID
+    case 0xAB:
+        if (n <= 3)
+        {
+            d->addr = (d->addr << 8) | mosi;
+            return(0xFF);
+        }
+        return(((n - 4 + (d->addr & 1)) & 1) ? (d->chip->rdid & 0xFF) : (d->chip->rdid >> 8));
+
+    case 0x5A: // SFDP
+        if (n <= 3)
+        {
+            d->addr = (d->addr << 8) | mosi;
+            return(0xFF);
+        }
+        if ((n == 4) || (d->chip->sfdp == NULL) || (d->addr >= d->chip->sfdpLen))
+        {
+            return(0xFF); // dummy byte, unsupported command or past the table
+        }
+        return(d->chip->sfdp[d->addr++]);
+
+    case 0x9F: // JEDEC ID
+        if (n <= 3)
+        {
+            return((d->chip->jedec >> (8 * (3 - n))) & 0xFF);
+        }
+        return(0xFF);
+
+    default:
+        // Write-type commands: collect address and data for execution at CE release
+        if ((d->cmd == 0xAD) && d->aai)
+        {
+            if (n <= 2) d->data[n - 1] = mosi;
+        }
+        else if ((n <= 3) && (d->cmd != 0x01))
+        {
+            d->addr = (d->addr << 8) | mosi;
+        }
+        else
+        {
+            if (d->dataLen == sizeof(d->data))
+            {
+                memmove(d->data, d->data + 1, sizeof(d->data) - 1);
+                d->dataLen--;
+            }
+            d->data[d->dataLen++] = mosi;
+        }
+        return(0xFF);
+    }
+}
+
+///\endcond
+//==================================================================================================
+// Functions
+//==================================================================================================
+
+void sstSim_Init(void)
+{
+    uint8_t i;
+    for (i = 0; i < DevCount; i++)
+    {
+        free(Devs[i].mem);
+    }
+    memset(Devs, 0, sizeof(Devs));
+    DevCount = 0;
+    Now = 0;
+    memset(&Stats, 0, sizeof(Stats));
+}
+
+//--------------------------------------------------------------------------------------------------
+RES_t sstSim_AddDevice(uint16_t ce, uint8_t bus, sstSimType_t type)
+{
+    simDev_t *d;
+
+    if ((DevCount >= SIM_MAX_DEVICES) || (type >= SIM_TYPE_COUNT))
+    {
+        return(RES_FULL);
+    }
+
+    d = &Devs[DevCount++];
+    memset(d, 0, sizeof(simDev_t));
+    d->chip = &CHIPS[type];
+    d->ce = ce;
+    d->bus = bus;
+    d->sr = d->chip->srPowerUp;
+    d->mem = malloc(d->chip->size);
+    memset(d->mem, 0xFF, d->chip->size);
+    return(RES_OK);
+}
+
+//--------------------------------------------------------------------------------------------------
+const char* sstSim_TypeName(sstSimType_t type)
+{
+    return((type < SIM_TYPE_COUNT) ? CHIPS[type].name : "?");
+}
+
+//--------------------------------------------------------------------------------------------------
+void sstSim_CE(uint16_t mask, uint8_t level)
+{
+    uint8_t i;
+    simDev_t *d;
+
+    if (level == 0)
+    {
+        Now += SIM_CE_OVERHEAD_NS;
+        Stats.timeNs += SIM_CE_OVERHEAD_NS;
+    }
+
+    for (i = 0; i < DevCount; i++)
+    {
+        d = &Devs[i];
+        if ((d->ce & mask) == 0)
+        {
+            continue;
+        }
+
+        if ((level == 0) && !d->selected)
+        {
+            d->selected = 1;
+            d->count = 0;
+            d->ignore = 0;
+            Stats.transactions++;
+        }
+        else if ((level != 0) && d->selected)
+        {
+            d->selected = 0;
+            if ((d->count > 0) && !d->ignore)
+            {
+                execute(d);
+            }
+        }
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+uint8_t sstSim_Transfer(uint8_t bus, uint8_t mosi, uint32_t sclkHz)
+{
+    uint8_t i;
+    uint8_t miso = 0xFF;
+    uint32_t t = (uint32_t)((8ULL * 1000000000ULL + sclkHz - 1) / sclkHz);
+
+    Now += t;
+    Stats.timeNs += t;
+    Stats.bytes++;
+
+    for (i = 0; i < DevCount; i++)
+    {
+        if (Devs[i].selected && (Devs[i].bus == bus))
+        {
+            miso &= clockByte(&Devs[i], mosi, sclkHz);
+        }
+    }
+    return(miso);
+}
+
+//--------------------------------------------------------------------------------------------------
+uint8_t sstSim_SOLevel(uint8_t bus)
+{
+    uint8_t i;
+    simDev_t *d;
+
+    for (i = 0; i < DevCount; i++)
+    {
+        d = &Devs[i];
+        if (d->selected && (d->bus == bus) && d->ebsy && d->aai && (d->count == 0) && isBusy(d))
+        {
+            return(0);
+        }
+    }
+    return(1);
+}
+
+//--------------------------------------------------------------------------------------------------
+void sstSim_Advance(uint32_t ns)
+{
+    Now += ns;
+    Stats.timeNs += ns;
+}
+
+//--------------------------------------------------------------------------------------------------
+uint64_t sstSim_Now(void)
+{
+    return(Now);
+}
+
+//--------------------------------------------------------------------------------------------------
+const sstSimStats_t* sstSim_GetStats(void)
+{
+    return(&Stats);
+}
+
+//--------------------------------------------------------------------------------------------------
+void sstSim_ClearStats(void)
+{
+    memset(&Stats, 0, sizeof(Stats));
+}
+
+//--------------------------------------------------------------------------------------------------
+uint8_t sstSim_Peek(uint16_t ce, uint32_t addr)
+{
+    uint8_t i;
+    for (i = 0; i < DevCount; i++)
+    {
+        if (Devs[i].ce == ce)
+        {
+            return(Devs[i].mem[addr % Devs[i].chip->size]);
+        }
+    }
+    return(0xFF);
+}
+
+#endif // __MSP430__
+
+///\}
@@ -0,0 +1,220 @@
+/*
+* Copyright (c) 2012, Alexander I. Mykyta
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+* ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/**
+* \addtogroup MOD_SST25VF_SIM SST25VF Serial Flash Simulator
+* \brief Host-side model of SST25VF and MX25R serial flash devices
+*
+* Replaces the MSP430 hardware when the project is compiled for a host (any target other than
+* \c __MSP430__). spi_sim.c implements the \ref MOD_SPI "SPI Bus" API on top of this model, and
+* the \ref MOD_SST25VF "SST25VF Serial Flash" driver routes its chip enables here. The rest of the
+* code runs unmodified. \n \n
+*
+* The model implements the command sets of the SST25VF040B/080B/016B/032B, the MX25R1035F and
+* the W25Q16JV:
+* RDID, JEDEC ID, RDSR/WRSR/EWSR, WREN/WRDI, byte program, AAI word program (SST), page
+* program (MX25R), 4K/32K/64K/chip erase, EBSY/DBSY including the RY/BY# output on SO, and SFDP
+* (MX25R, W25Q).
+* Programming only clears bits. Program
+* and erase operations keep the device busy for the datasheet typical time. \n \n
+*
+* Time is modeled, not measured. Every SPI byte advances the clock by 8 bit-times of the active
+* bus profile and every chip-enable assertion by #SIM_CE_OVERHEAD_NS. Background (DMA) frames
+* complete immediately, so overlap between buses is not modeled. \n \n
+*
+* Protocol violations, such as commands sent while the device is busy or programs without WEL,
+* are counted in sstSimStats_t::errors and described on stderr. \n \n
+*
+* Build the host benchmark with:
+* \code
+* gcc -O2 -Wall -Wextra -I. -o sim_bench sim_bench.c SST25VF_sim.c spi_sim.c spi_queue.c SST25VF.c \
+*     FlashSPAN_SST25VF.c FlashFTL.c FlashLog.c
+* \endcode
+*
+* \{
+**/
+
+/**
+* \file
+* \brief Include file for \ref MOD_SST25VF_SIM "SST25VF Serial Flash Simulator"
+**/
+
+#ifndef _SST25VF_SIM_H_
+#define _SST25VF_SIM_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include "result.h"
+
+//==================================================================================================
+// Stand-ins for MSP430 definitions used by the drivers
+//==================================================================================================
+///\cond INTERNAL
+#ifndef BIT0
+#define BIT0    0x01
+#define BIT1    0x02
+#define BIT2    0x04
+#define BIT3    0x08
+#define BIT4    0x10
+#define BIT5    0x20
+#define BIT6    0x40
+#define BIT7    0x80
+#endif
+
+#define UCCKPH  0x80
+#define UCCKPL  0x40
+///\endcond
+
+//==================================================================================================
+// Configuration
+//==================================================================================================
+
+/// Maximum number of simulated devices
+#define SIM_MAX_DEVICES     16
+
+/// Modeled CPU time for asserting a chip enable (GPIO write plus call overhead)
+#define SIM_CE_OVERHEAD_NS  400
+
+/// Modeled CPU time for one iteration of a loop that samples a pin
+#define SIM_PIN_SAMPLE_NS   160
+
+//==================================================================================================
+// Types
+//==================================================================================================
+
+    ///\brief Simulated device types
+    typedef enum
+    {
+        SIM_SST25VF040,
+        SIM_SST25VF080,
+        SIM_SST25VF016,
+        SIM_SST25VF032,
+        SIM_MX25R1035F,
+        SIM_W25Q16JV,       ///< Not in the driver's device table. Only usable through SFDP.
+        SIM_SFDP16M,        ///< Generic SFDP-only part whose table also gives byte program times
+        SIM_TYPE_COUNT
+    } sstSimType_t;
+
+    ///\brief Simulator statistics
+    typedef struct
+    {
+        uint64_t timeNs;            ///< Modeled elapsed time in ns
+        uint32_t bytes;             ///< SPI bytes clocked
+        uint32_t transactions;      ///< Chip-enable assertions
+        uint32_t errors;            ///< Protocol violations
+        uint32_t bitConflicts;      ///< Programmed bytes that tried to change a 0 bit back to 1
+        uint32_t unsupported;       ///< Opcodes the device does not implement (ignored, like the real parts)
+        uint32_t opcodes[256];      ///< Transactions per opcode
+    } sstSimStats_t;
+
+//==================================================================================================
+// Function Prototypes
+//==================================================================================================
+
+    /**
+    * \brief Removes all devices and resets time and statistics
+    **/
+    void sstSim_Init(void);
+
+    /**
+    * \brief Attaches a device to the simulator in its power-up state
+    * \param [in] ce Chip-enable mask of the device. In one-hot CE mode this is \c SST_CE_DEVn_BIT
+    *                for devices 0-7 and <tt>SST_CE_DEVn_BIT << 8</tt> for devices 8-15. In
+    *                addressed CE mode device n has the mask <tt>1 << n</tt>.
+    * \param [in] bus Index of the SPI bus the device is connected to
+    * \param [in] type Device type
+    * \retval RES_OK
+    * \retval RES_FULL Too many devices
+    **/
+    RES_t sstSim_AddDevice(uint16_t ce, uint8_t bus, sstSimType_t type);
+
+    /**
+    * \brief Get the name of a device type
+    **/
+    const char* sstSim_TypeName(sstSimType_t type);
+
+    /**
+    * \brief Drives chip-enable lines
+    * \param [in] mask Chip-enable masks to drive
+    * \param [in] level 0 = asserted (low), 1 = released (high)
+    **/
+    void sstSim_CE(uint16_t mask, uint8_t level);
+
+    /**
+    * \brief Clocks one byte on a bus
+    * \param [in] bus Bus index
+    * \param [in] mosi Byte sent by the master
+    * \param [in] sclkHz Bus clock frequency. Used for timing and clock limit checks.
+    * \return Byte driven by the selected devices (0xFF if none)
+    **/
+    uint8_t sstSim_Transfer(uint8_t bus, uint8_t mosi, uint32_t sclkHz);
+
+    /**
+    * \brief Get the level that the selected devices drive on SO without clocking the bus
+    * \param [in] bus Bus index
+    * \return 0 if a selected device in AAI mode with EBSY enabled is busy, otherwise 1
+    *
+    * Models the RY/BY# output of SST devices: once EBSY has been issued, SO shows the ready
+    * state while CE is low and no command has been clocked yet.
+    **/
+    uint8_t sstSim_SOLevel(uint8_t bus);
+
+    /**
+    * \brief Advances modeled time
+    **/
+    void sstSim_Advance(uint32_t ns);
+
+    /**
+    * \brief Get the current modeled time in ns
+    **/
+    uint64_t sstSim_Now(void);
+
+    /**
+    * \brief Get a pointer to the statistics
+    **/
+    const sstSimStats_t* sstSim_GetStats(void);
+
+    /**
+    * \brief Clears the statistics. Modeled time keeps running.
+    **/
+    void sstSim_ClearStats(void);
+
+    /**
+    * \brief Reads simulated memory directly, without any bus traffic
+    * \param [in] ce Chip-enable mask of the device
+    * \param [in] addr Address within the device
+    * \return Memory contents or 0xFF if there is no such device
+    **/
+    uint8_t sstSim_Peek(uint16_t ce, uint32_t addr);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+///\}
@@ -0,0 +1,151 @@
+/*
+* Copyright (c) 2012, Alexander I. Mykyta
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+* ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/**
+* \addtogroup MOD_CLOCK
+* \{
+**/
+
+/**
+* \file
+* \brief Code for \ref MOD_CLOCK "Clock Setup"
+**/
+
+#include <stdint.h>
+
+#include <msp430.h>
+#include "clock.h"
+
+//==================================================================================================
+// Internal Functions
+//==================================================================================================
+///\cond INTERNAL
+
+#define FLL_N    (CLOCK_FLL_N - 1)
+
+#if (CLOCK_MCLK_FREQ > 25000000L)
+#error "CLOCK_MCLK_FREQ exceeds the device maximum"
+#endif
+
+#if CLOCK_TICKS
+static volatile uint16_t TicksHigh;     // Timer_B0 overflows
+#endif
+
+//--------------------------------------------------------------------------------------------------
+// Raise the core voltage by one step. See the PMM chapter in the 5xx user's guide.
+static void setVCoreUp(uint8_t level)
+{
+    PMMCTL0_H = PMMPW_H;
+    SVSMHCTL = SVSHE + SVSHRVL0 * level + SVMHE + SVSMHRRL0 * level;
+    SVSMLCTL = SVSLE + SVMLE + SVSMLRRL0 * level;
+    while ((PMMIFG & SVSMLDLYIFG) == 0);
+    PMMIFG &= ~(SVMLVLRIFG + SVMLIFG);
+    PMMCTL0_L = PMMCOREV0 * level;
+    if ((PMMIFG & SVMLIFG))
+    {
+        while ((PMMIFG & SVMLVLRIFG) == 0);
+    }
+    SVSMLCTL = SVSLE + SVSLRVL0 * level + SVMLE + SVSMLRRL0 * level;
+    PMMCTL0_H = 0x00;
+}
+
+///\endcond
+//==================================================================================================
+// Functions
+//==================================================================================================
+
+void clockInit(void)
+{
+    uint8_t level;
+
+    // The core voltage must be raised one level at a time
+    for (level = 1; level <= CLOCK_VCORE_LEVEL; level++)
+    {
+        setVCoreUp(level);
+    }
+
+    UCSCTL3 = SELREF__REFOCLK;  // FLL reference = REFO
+    UCSCTL4 = SELA__REFOCLK + SELS__DCOCLKDIV + SELM__DCOCLKDIV;
+
+    __bis_SR_register(SCG0);    // Disable the FLL control loop
+    UCSCTL0 = 0x0000;           // Lowest DCOx, MODx
+    UCSCTL1 = DCORSEL_7;        // DCO range for up to 50 MHz DCOCLK
+    UCSCTL2 = FLLD_1 + FLL_N;   // DCOCLKDIV = (N + 1) * FLLREF, DCOCLK = 2 * DCOCLKDIV
+    __bic_SR_register(SCG0);    // Enable the FLL control loop
+
+    // Worst-case DCO settling time is 32 x 32 x fMCLK / fFLLREF reference cycles
+    __delay_cycles(32L * 32L * CLOCK_FLL_N);
+
+    // Wait for the oscillator fault flags to clear
+    do
+    {
+        UCSCTL7 &= ~(XT2OFFG + XT1LFOFFG + DCOFFG);
+        SFRIFG1 &= ~OFIFG;
+    } while (SFRIFG1 & OFIFG);
+
+#if CLOCK_TICKS
+    TicksHigh = 0;
+    TB0CTL = TBSSEL__SMCLK + ID__8 + TBCLR;
+    TB0EX0 = TBIDEX__3;
+    TB0CTL |= MC__CONTINUOUS + TBIE;
+#endif
+}
+
+#if CLOCK_TICKS
+//--------------------------------------------------------------------------------------------------
+uint32_t clockTicks(void)
+{
+    uint16_t gie = __get_SR_register() & GIE;
+    uint16_t high;
+    uint16_t low;
+
+    __disable_interrupt();
+    __no_operation();
+    high = TicksHigh;
+    low = TB0R;
+    // An overflow that the interrupt has not counted yet. A small count means it came first.
+    if ((TB0CTL & TBIFG) && (low < 0x8000))
+    {
+        high++;
+    }
+    __bis_SR_register(gie);
+    return(((uint32_t)high << 16) | low);
+}
+
+//--------------------------------------------------------------------------------------------------
+/**
+* \brief Timer_B0 overflow ISR
+**/
+#pragma vector=TIMER0_B1_VECTOR
+__interrupt void clock_Tick_ISR(void)
+{
+    if (__even_in_range(TB0IV, 14) == 14) // TBIFG
+    {
+        TicksHigh++;
+    }
+}
+#endif
+
+///\}
@@ -0,0 +1,92 @@
+/*
+* Copyright (c) 2012, Alexander I. Mykyta
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+* ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/**
+* \addtogroup MOD_CLOCK Clock Setup
+* \brief Configures the Unified Clock System of the MSP430F5xx
+*
+* Raises the core voltage and locks the DCO to REFO with the FLL so that MCLK and SMCLK run at
+* #CLOCK_MCLK_FREQ. ACLK runs from REFO.
+*
+* \{
+**/
+
+/**
+* \file
+* \brief Include file for \ref MOD_CLOCK "Clock Setup"
+**/
+
+#ifndef _CLOCK_H_
+#define _CLOCK_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include "clock_config.h"
+
+//==================================================================================================
+// Defines
+//==================================================================================================
+
+/// FLL multiplier: DCOCLKDIV = #CLOCK_FLL_N * #CLOCK_FLLREF_FREQ
+#define CLOCK_FLL_N         (CLOCK_MCLK_FREQ / CLOCK_FLLREF_FREQ)
+
+/// MCLK and SMCLK frequency after clockInit(): #CLOCK_MCLK_FREQ rounded down to a multiple of
+/// #CLOCK_FLLREF_FREQ
+#define CLOCK_SMCLK_FREQ    (CLOCK_FLL_N * CLOCK_FLLREF_FREQ)
+
+/// Rate of clockTicks() in Hz
+#define CLOCK_TICK_FREQ     (CLOCK_SMCLK_FREQ / 24)
+
+//==================================================================================================
+// Function Prototypes
+//==================================================================================================
+
+    /**
+    * \brief Brings MCLK and SMCLK up to #CLOCK_MCLK_FREQ
+    * \attention Call this before initializing any peripherals that depend on SMCLK
+    **/
+    void clockInit(void);
+
+#if CLOCK_TICKS
+    /**
+    * \brief Get the tick count
+    * \return Ticks of #CLOCK_TICK_FREQ since clockInit(). Wraps at 32 bits.
+    *
+    * Can be called with interrupts disabled and from interrupt service routines. The overflows
+    * are counted by an interrupt, so interrupts must not stay disabled for more than one
+    * Timer_B0 period (65536 ticks).
+    **/
+    uint32_t clockTicks(void);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+///\}
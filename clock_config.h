@@ -0,0 +1,45 @@
+/**
+* \addtogroup MOD_CLOCK
+* \{
+**/
+
+/**
+* \file
+* \brief Configuration include file for \ref MOD_CLOCK "Clock Setup"
+**/
+
+#ifndef _CLOCK_CONFIG_H_
+#define _CLOCK_CONFIG_H_
+
+//==================================================================================================
+/// \name Configuration
+/// Configuration defines for the \ref MOD_CLOCK module
+/// \{
+//==================================================================================================
+
+/// FLL reference frequency in Hz (REFO)
+#define CLOCK_FLLREF_FREQ   32768L      ///< \hideinitializer
+
+/// Target MCLK and SMCLK frequency in Hz. 25 MHz is the maximum for the F5529 at PMMCOREV_3.
+#define CLOCK_MCLK_FREQ     25000000L   ///< \hideinitializer
+
+/// Core voltage level required for #CLOCK_MCLK_FREQ
+#define CLOCK_VCORE_LEVEL   3           ///< \hideinitializer
+/**<    0 = up to 8 MHz \n
+*       1 = up to 12 MHz \n
+*       2 = up to 20 MHz \n
+*       3 = up to 25 MHz
+**/
+
+/// Free-running tick counter read by clockTicks()
+#define CLOCK_TICKS         1           ///< \hideinitializer
+/**<    0 = Timer_B0 is left to the application \n
+*       1 = clockInit() runs Timer_B0 from SMCLK / 24 (#CLOCK_TICK_FREQ, about 1 MHz) and counts
+*           its overflows in the Timer_B0 interrupt
+**/
+
+///\}
+
+#endif
+
+///\}
@@ -141,6 +141,7 @@ SECTIONS
     .TI.noinit  : {} > RAM                  /* For #pragma noinit                */
     .sysmem     : {} > RAM                  /* Dynamic memory allocation area    */
     .stack      : {} > RAM (HIGH)           /* Software system stack             */
+    .usbram     : {} > USBRAM               /* Uninitialized vars in USB RAM     */
 
 #ifndef __LARGE_DATA_MODEL__
     .text       : {}>> FLASH                /* Code                              */
@@ -4,6 +4,7 @@
 #include    "SST25VF.h"
 #include    "spi.h"
 #include    "FlashSPAN.h"
+#include    "clock.h"
 
 
 unsigned char upper_128[128];
@@ -14,6 +15,7 @@ unsigned char upper_128[128];
 int main(void)
 {
     WDTCTL = WDTPW | WDTHOLD;	// Stop watchdog timer
+    clockInit();
 
 	int	i, ret ,ret1;
 	unsigned long temp;
@@ -0,0 +1,961 @@
+/*
+* Copyright (c) 2012, Alexander I. Mykyta
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+* ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/**
+* \addtogroup MOD_SST25VF_SIM
+* \{
+**/
+
+/**
+* \file
+* \brief Host benchmark of the flash driver paths on the
+*        \ref MOD_SST25VF_SIM "SST25VF Serial Flash Simulator"
+*
+* Builds a volume of #FLASH_DEVICECOUNT devices of each simulated type. Runs init, erase-all, a
+* 4 KB write and a 4 KB read-back through \ref MOD_FLASHSPAN "FlashSPAN", then dumps device 0 with
+* one sst25vf_Read() and erases all but the first and last block of the volume by range and block
+* by block. Then measures reads during a background erase, 64 KB of sequential 4 KB writes, sparse
+* record writes and header/payload records written with two calls each and with one
+* flashSPAN_WriteV(). With #FLASH_CACHE_LINES, compares re-reads of small headers through the read
+* cache and directly from the devices. With #FLASH_OVERWRITE, compares counter and record updates
+* by hand-rolled read-erase-write and by flashSPAN_Overwrite(). Runs an endurance test of skewed
+* sector writes through the \ref MOD_FLASHFTL "FTL" and, with #FLASH_OVERWRITE, in place. Appends
+* records to a \ref MOD_FLASHLOG "record log" over the whole volume until it wraps around, then
+* times its mount and reads the records back. With #FLASH_ASYNC, compares reads mixed with an
+* erase and write issued by the blocking functions and by flashSPAN_Submit(). Prints the SPI
+* traffic and modeled time of each step.
+**/
+
+#ifndef __MSP430__
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "SST25VF_sim.h"
+#include "SST25VF.h"
+#include "FlashSPAN.h"
+#include "FlashFTL.h"
+#include "FlashLog.h"
+
+///\cond INTERNAL
+
+#define BENCH_SIZE  4096
+
+// Reads issued during a background erase
+#define BG_READ_SIZE        256
+#define BG_READ_PERIOD_NS   1000000UL
+
+// Records of a header and a payload, written without copying them together
+#define REC_COUNT           16
+#define REC_HDR_SIZE        5
+#define REC_SIZE            256
+
+// Reads of the last block submitted together with an erase and write of block 0
+#define ASYNC_READS         8
+#define ASYNC_READ_SIZE     256
+
+// Small metadata reads that keep returning to the same places, with a write every META_WRITE_EVERY
+#define META_SPOTS          8
+#define META_SIZE           16
+#define META_READS          512
+#define META_WRITE_EVERY    64
+
+// Counter bits cleared one per update and a 16 byte record rewritten every OVW_RECORD_EVERY updates
+#define OVW_UPDATES         64
+#define OVW_COUNTER         0x10
+#define OVW_RECORD          0x40
+#define OVW_RECORD_EVERY    8
+
+// Endurance run of the FTL: sector writes of which FTL_HOT_PERCENT go to the first
+// FTL_HOT_SECTORS sectors
+#define FTL_WRITES          2000
+#define FTL_HOT_PERCENT     80
+#define FTL_HOT_SECTORS     (FTL_SECTOR_COUNT / 5)
+
+// Record log run: small sensor records, appended until the log has wrapped around once and a
+// half, with a mount in the first pass
+#define LOG_REC_SIZE        32
+#define LOG_LAPS_X2         3
+
+// Device address of the three 4 KB blocks of queueErase()
+#define QUEUE_ADDR          0x1000UL
+
+// Sequential log-style writes into the area erased by backgroundErase()
+#define APPEND_SIZE         0x10000UL
+
+// Read latency histogram bin limits in ns. The last bin holds everything above.
+#define LAT_BINS    5
+static const uint64_t LAT_LIMIT[LAT_BINS - 1] = {100000ULL, 1000000ULL, 10000000ULL, 100000000ULL};
+static const char *LAT_NAME[LAT_BINS] = {"<0.1ms", "<1ms", "<10ms", "<100ms", ">=100ms"};
+
+static uint8_t WrBuf[BENCH_SIZE];
+static uint8_t SparseBuf[BENCH_SIZE];
+static uint8_t RdBuf[BENCH_SIZE];
+static uint8_t DumpBuf[0x400000];
+static flashSPAN_iovec_t RecIov[REC_COUNT * 2];
+static flashSPAN_iovec_t RecRdIov[REC_COUNT];
+static uint16_t FtlLast[FTL_SECTOR_COUNT];
+static uint32_t Rand;
+
+#if SST_CE_MODE == 0
+static const uint16_t CE_MASKS[] = {SST_CE_DEV0_BIT, SST_CE_DEV1_BIT, SST_CE_DEV2_BIT, SST_CE_DEV3_BIT,
+                                    SST_CE_DEV4_BIT, SST_CE_DEV5_BIT, SST_CE_DEV6_BIT, SST_CE_DEV7_BIT,
+                                    SST_CE_DEV8_BIT << 8, SST_CE_DEV9_BIT << 8, SST_CE_DEV10_BIT << 8,
+                                    SST_CE_DEV11_BIT << 8, SST_CE_DEV12_BIT << 8,
+                                    SST_CE_DEV13_BIT << 8, SST_CE_DEV14_BIT << 8,
+                                    SST_CE_DEV15_BIT << 8};
+static const uint8_t BUSES[] = {SST_DEV0_BUS, SST_DEV1_BUS, SST_DEV2_BUS, SST_DEV3_BUS,
+                                SST_DEV4_BUS, SST_DEV5_BUS, SST_DEV6_BUS, SST_DEV7_BUS,
+                                SST_DEV8_BUS, SST_DEV9_BUS, SST_DEV10_BUS, SST_DEV11_BUS,
+                                SST_DEV12_BUS, SST_DEV13_BUS, SST_DEV14_BUS, SST_DEV15_BUS};
+#define SIM_CE(d)   CE_MASKS[d]
+#define SIM_BUS(d)  BUSES[d]
+#else
+#define SIM_CE(d)   ((uint16_t)1 << (d))
+#define SIM_BUS(d)  0
+#endif
+
+// Print the statistics collected since the last call
+static void report(const char *step)
+{
+    const sstSimStats_t *s = sstSim_GetStats();
+
+    printf("  %-10s %9lu bytes %7lu CE %12.3f ms %6lu errors", step,
+            (unsigned long)s->bytes, (unsigned long)s->transactions,
+            s->timeNs / 1e6, (unsigned long)s->errors);
+#if SST_CACHE_STATUS
+    printf(" %5lu elided", (unsigned long)(sst25vf_Elided.WREN + sst25vf_Elided.WRSR
+            + sst25vf_Elided.RDSR + sst25vf_Elided.EBSY + sst25vf_Elided.DBSY));
+    memset(&sst25vf_Elided, 0, sizeof(sst25vf_Elided));
+#endif
+    printf("\n");
+    sstSim_ClearStats();
+}
+
+// Read block 0 periodically while the rest of the volume erases in the background
+static void backgroundErase(void)
+{
+    uint32_t hist[LAT_BINS];
+    uint32_t reads;
+    uint64_t t;
+    uint64_t lat;
+    uint64_t worst;
+    uint8_t bin;
+
+    memset(hist, 0, sizeof(hist));
+    reads = 0;
+    worst = 0;
+
+    flashSPAN_EraseRangeStart(FLASH_VOLUME_BLOCKSIZE, (flashSPAN.BlockCount - 1) * FLASH_VOLUME_BLOCKSIZE);
+    while (flashSPAN_EraseService())
+    {
+        sstSim_Advance(BG_READ_PERIOD_NS);
+
+        t = sstSim_Now();
+        flashSPAN_Read(0, RdBuf, BG_READ_SIZE);
+        lat = sstSim_Now() - t;
+
+        for (bin = 0; bin < (LAT_BINS - 1); bin++)
+        {
+            if (lat < LAT_LIMIT[bin])
+            {
+                break;
+            }
+        }
+        hist[bin]++;
+        reads++;
+        if (lat > worst)
+        {
+            worst = lat;
+        }
+    }
+    report("bg erase");
+
+    printf("  bg reads   %lu, worst %.3f ms:", (unsigned long)reads, worst / 1e6);
+    for (bin = 0; bin < LAT_BINS; bin++)
+    {
+        printf(" %s %lu", LAT_NAME[bin], (unsigned long)hist[bin]);
+    }
+    printf("\n");
+}
+
+#if FLASH_CACHE_LINES
+// Re-read headers spread over the first and last block, once with flashSPAN_Read() through the
+// cache and once with flashSPAN_ReadV(), which always reads the devices. A third, unreported pass
+// compares both.
+static void metaReads(void)
+{
+    const flashSPAN_cacheStats_t *c = flashSPAN_GetCacheStats();
+    flashSPAN_iovec_t iov;
+    uint32_t last = (flashSPAN.BlockCount - 1) * FLASH_VOLUME_BLOCKSIZE;
+    uint32_t addr;
+    uint16_t bad = 0;
+    uint16_t r;
+    uint8_t pass;
+
+    iov.data = &RdBuf[META_SIZE];
+    iov.nBytes = META_SIZE;
+    for (pass = 0; pass < 3; pass++)
+    {
+        flashSPAN_EraseBlock(0);
+        flashSPAN_FlushCache();
+        flashSPAN_ClearCacheStats();
+        sstSim_ClearStats();
+        for (r = 0; r < META_READS; r++)
+        {
+            addr = ((r % META_SPOTS) & 1) ? last : 0;
+            addr += (r % META_SPOTS) * 0x100 + META_SIZE * ((r / META_SPOTS) % 4);
+
+            // Append a header now and then, over the first spot
+            if ((r % META_WRITE_EVERY) == 0)
+            {
+                flashSPAN_Write((r / META_WRITE_EVERY) * META_SIZE, &WrBuf[r], META_SIZE);
+            }
+
+            if (pass != 1)
+            {
+                flashSPAN_Read(addr, RdBuf, META_SIZE);
+            }
+            if (pass != 0)
+            {
+                flashSPAN_ReadV(addr, &iov, 1);
+            }
+            if (pass == 2)
+            {
+                bad += memcmp(RdBuf, &RdBuf[META_SIZE], META_SIZE) ? 1 : 0;
+            }
+        }
+        if (pass == 2)
+        {
+            sstSim_ClearStats();
+            break;
+        }
+        report(pass ? "meta dev" : "meta cache");
+        if (pass == 0)
+        {
+            printf("  cache      %lu hits, %lu misses, %lu invalidated\n", (unsigned long)c->hits,
+                    (unsigned long)c->misses, (unsigned long)c->invalidated);
+        }
+    }
+    printf("  verify     %u mismatches\n", bad);
+}
+#endif
+
+// Pseudo random number for the endurance run
+static uint16_t nextRand(void)
+{
+    Rand = Rand * 1103515245UL + 12345;
+    return((uint16_t)(Rand >> 16));
+}
+
+// Sector of the n-th write of the endurance run. Call in order.
+static uint16_t ftlSector(uint16_t n)
+{
+    if (n < FTL_SECTOR_COUNT)
+    {
+        return(n);
+    }
+    if ((nextRand() % 100) < FTL_HOT_PERCENT)
+    {
+        return(nextRand() % FTL_HOT_SECTORS);
+    }
+    return(FTL_HOT_SECTORS + nextRand() % (FTL_SECTOR_COUNT - FTL_HOT_SECTORS));
+}
+
+// Data of the n-th write of the endurance run
+static uint8_t* ftlData(uint16_t n)
+{
+    return(&WrBuf[(n * 61UL) % (BENCH_SIZE - FTL_SECTOR_SIZE)]);
+}
+
+// Compares every sector with the data last written to it
+static uint16_t ftlVerify(void)
+{
+    uint16_t s;
+    uint16_t bad = 0;
+
+    for (s = 0; s < FTL_SECTOR_COUNT; s++)
+    {
+        flashFTL_Read(s, RdBuf);
+        bad += memcmp(RdBuf, ftlData(FtlLast[s]), FTL_SECTOR_SIZE) ? 1 : 0;
+    }
+    sstSim_ClearStats();
+    return(bad);
+}
+
+// Write every sector once, then FTL_WRITES skewed sector writes through the FTL, with a garbage
+// collection step after each write
+static void ftlEndurance(void)
+{
+    const flashFTL_stats_t *f;
+    uint32_t host;
+    uint32_t pages;
+    uint16_t n;
+    uint16_t s;
+    uint16_t bad;
+
+    if (flashFTL_Format() != RES_OK)
+    {
+        printf("  ftl        format failed\n");
+        return;
+    }
+    sstSim_ClearStats();
+
+    Rand = 1;
+    for (n = 0; n < FTL_SECTOR_COUNT + FTL_WRITES; n++)
+    {
+        s = ftlSector(n);
+        if (flashFTL_Write(s, ftlData(n)) != RES_OK)
+        {
+            printf("  ftl        write %u failed\n", n);
+            return;
+        }
+        FtlLast[s] = n;
+        if (n == (FTL_SECTOR_COUNT - 1))
+        {
+            report("ftl fill");
+            f = flashFTL_GetStats();
+            host = f->hostWrites;
+            pages = f->pageWrites;
+        }
+        else if (n >= FTL_SECTOR_COUNT)
+        {
+            flashFTL_Service();
+        }
+    }
+    report("ftl writes");
+    f = flashFTL_GetStats();
+    bad = ftlVerify();
+    printf("  ftl        WA %.2f, %lu moves, erases %lu..%lu avg %.1f, %u mismatches",
+            (double)(f->pageWrites - pages) / (f->hostWrites - host), (unsigned long)f->relocations,
+            (unsigned long)f->minErase, (unsigned long)f->maxErase,
+            (double)f->eraseSum / FTL_BLOCKS, bad);
+    flashFTL_Mount();
+    printf(", %u after remount\n", ftlVerify());
+}
+
+// Cuts the power while garbage collection moves pages into the last free block, then mounts and
+// keeps writing. Continues the write sequence of ftlEndurance().
+static void ftlPowerLoss(void)
+{
+    const flashFTL_stats_t *f = flashFTL_GetStats();
+    uint16_t n = FTL_SECTOR_COUNT + FTL_WRITES;
+    uint16_t end;
+    uint16_t s;
+
+    // Host writes stop at one free block, the steps of flashFTL_Service() then open it
+    for (end = n + FTL_WRITES; (n < end) && (flashFTL_GetStats()->freeBlocks != 0); n++)
+    {
+        if (f->freeBlocks == 1)
+        {
+            flashFTL_Service();
+            continue;
+        }
+        s = ftlSector(n);
+        flashFTL_Write(s, ftlData(n));
+        FtlLast[s] = n;
+    }
+    if (n == end)
+    {
+        printf("  ftl        power loss skipped, no free block left to the collector\n");
+        return;
+    }
+
+    flashSPAN_Init();
+    if (flashFTL_Mount() != RES_OK)
+    {
+        printf("  ftl        mount after power loss failed\n");
+        return;
+    }
+    for (end = n + FTL_WRITES; n < end; n++)
+    {
+        s = ftlSector(n);
+        if (flashFTL_Write(s, ftlData(n)) != RES_OK)
+        {
+            printf("  ftl        write %u after power loss failed, %u mismatches\n", n, ftlVerify());
+            return;
+        }
+        FtlLast[s] = n;
+        flashFTL_Service();
+    }
+    printf("  ftl        power loss during GC, %u mismatches\n", ftlVerify());
+}
+
+// Fills the record of number n
+static void logRecord(uint32_t n, uint8_t *rec)
+{
+    uint8_t i;
+
+    memcpy(rec, &n, sizeof(n));
+    for (i = sizeof(n); i < LOG_REC_SIZE; i++)
+    {
+        rec[i] = (uint8_t)(n + i);
+    }
+}
+
+// Appends records with a service call after each, mounts and reads every record that survived
+// the wrap-around
+static void logStore(void)
+{
+    const flashLog_stats_t *l;
+    flashLog_cursor_t cur;
+    uint8_t rec[LOG_REC_SIZE];
+    uint8_t buf[LOG_MAX_RECORD];
+    uint32_t total;
+    uint32_t n;
+    uint32_t first = 0;
+    uint32_t count = 0;
+    uint32_t bad = 0;
+    uint16_t len;
+    double us;
+    RES_t res;
+
+    if (flashLog_Format() != RES_OK)
+    {
+        printf("  log        format failed\n");
+        return;
+    }
+    report("log format");
+
+    total = flashSPAN.BlockCount * FLASH_VOLUME_BLOCKSIZE / (LOG_REC_SIZE + 4) * LOG_LAPS_X2 / 2;
+    for (n = 0; n < total; n++)
+    {
+        if (n == (total / 4))
+        {
+            flashLog_Mount();
+        }
+        logRecord(n, rec);
+        if (flashLog_Append(rec, LOG_REC_SIZE) != RES_OK)
+        {
+            printf("  log        append %lu failed\n", (unsigned long)n);
+            return;
+        }
+        flashLog_Service();
+    }
+    us = sstSim_GetStats()->timeNs / 1e3 / total;
+    report("log append");
+    l = flashLog_GetStats();
+    printf("  log        %lu records of %u bytes, %.1f us each, %lu erases, %lu in append\n",
+            (unsigned long)total, LOG_REC_SIZE, us, (unsigned long)l->erases,
+            (unsigned long)l->syncErases);
+
+    if (flashLog_Mount() != RES_OK)
+    {
+        printf("  log        mount failed\n");
+        return;
+    }
+    report("log mount");
+    l = flashLog_GetStats();
+    printf("  log        %lu blocks, %u block headers read\n",
+            (unsigned long)flashSPAN.BlockCount, l->mountReads);
+
+    // For comparison, read every block header as a mount by full scan would
+    for (n = 0; n < flashSPAN.BlockCount; n++)
+    {
+        flashSPAN_Read(n * FLASH_VOLUME_BLOCKSIZE, buf, 8);
+    }
+    report("log scan");
+
+    flashLog_Rewind(&cur);
+    while ((res = flashLog_ReadNext(&cur, buf, &len)) != RES_NOTFOUND)
+    {
+        memcpy(&n, buf, sizeof(n));
+        if (count == 0)
+        {
+            first = n;
+        }
+        logRecord(first + count, rec);
+        if ((res != RES_OK) || (len != LOG_REC_SIZE) || memcmp(buf, rec, LOG_REC_SIZE))
+        {
+            bad++;
+        }
+        count++;
+    }
+    report("log read");
+    printf("  log        records %lu..%lu, %lu mismatches\n", (unsigned long)first,
+            (unsigned long)(first + count - 1), (unsigned long)bad);
+    if ((first + count) != total)
+    {
+        printf("  log        newest record missing\n");
+    }
+}
+
+#if FLASH_OVERWRITE && (FTL_FIRST_BLOCK == 0)
+static uint32_t RawErases[FTL_BLOCKS];
+
+// The writes of ftlEndurance() to the same sectors at fixed addresses from the start of the volume,
+// rewritten in place with flashSPAN_Overwrite()
+static void rawEndurance(void)
+{
+    const flashSPAN_overwriteStats_t *o = flashSPAN_GetOverwriteStats();
+    uint32_t merged;
+    uint32_t maxRaw = 0;
+    uint16_t n;
+    uint16_t s;
+
+    flashSPAN_EraseRange(0, FTL_BLOCKS * FLASH_VOLUME_BLOCKSIZE);
+    memset(RawErases, 0, sizeof(RawErases));
+    sstSim_ClearStats();
+    Rand = 1;
+    for (n = 0; n < FTL_SECTOR_COUNT + FTL_WRITES; n++)
+    {
+        s = ftlSector(n);
+        merged = o->merged;
+        flashSPAN_Overwrite((uint32_t)s * FTL_SECTOR_SIZE, ftlData(n), FTL_SECTOR_SIZE);
+        if (o->merged != merged)
+        {
+            RawErases[((uint32_t)s * FTL_SECTOR_SIZE) / FLASH_VOLUME_BLOCKSIZE]++;
+        }
+        if (n == (FTL_SECTOR_COUNT - 1))
+        {
+            report("raw fill");
+        }
+    }
+    report("raw writes");
+    merged = 0;
+    for (s = 0; s < FTL_BLOCKS; s++)
+    {
+        merged += RawErases[s];
+        if (RawErases[s] > maxRaw)
+        {
+            maxRaw = RawErases[s];
+        }
+    }
+    printf("  raw        %lu erases, most erased block %lu\n", (unsigned long)merged,
+            (unsigned long)maxRaw);
+}
+#endif
+
+#if FLASH_OVERWRITE
+// Update counters and records in block 0, once by reading, erasing and writing back the block for
+// every update and once with flashSPAN_Overwrite()
+static void overwrites(void)
+{
+    const sstSimStats_t *s = sstSim_GetStats();
+    const flashSPAN_overwriteStats_t *o = flashSPAN_GetOverwriteStats();
+    const sst25vf_info_t *info = sst25vf_GetInfo();
+    flashSPAN_overwriteStats_t base;
+    uint8_t *shadow = DumpBuf;
+    uint32_t addr;
+    uint32_t erases;
+    uint32_t conflicts;
+    uint16_t len;
+    uint16_t u;
+    uint8_t pass;
+    uint8_t t;
+
+    for (pass = 0; pass < 2; pass++)
+    {
+        flashSPAN_EraseBlock(0);
+        flashSPAN_Write(0, SparseBuf, BENCH_SIZE);
+        memcpy(shadow, SparseBuf, BENCH_SIZE);
+        base = *o;
+        sstSim_ClearStats();
+
+        for (u = 0; u < OVW_UPDATES; u++)
+        {
+            if ((u % OVW_RECORD_EVERY) == (OVW_RECORD_EVERY - 1))
+            {
+                addr = OVW_RECORD + (u / OVW_RECORD_EVERY) * 16;
+                len = 16;
+                memcpy(&shadow[addr], &WrBuf[u * 3], len);
+            }
+            else
+            {
+                addr = OVW_COUNTER + u / 8;
+                len = 1;
+                shadow[addr] &= ~(1 << (u % 8));
+            }
+
+            if (pass == 0)
+            {
+                flashSPAN_Read(0, RdBuf, BENCH_SIZE);
+                memcpy(&RdBuf[addr], &shadow[addr], len);
+                flashSPAN_EraseBlock(0);
+                flashSPAN_Write(0, RdBuf, BENCH_SIZE);
+            }
+            else
+            {
+                flashSPAN_Overwrite(addr, &shadow[addr], len);
+            }
+        }
+
+        erases = 0;
+        for (t = 0; t < SST_ETYPE_COUNT; t++)
+        {
+            erases += info->eraseCmd[t] ? s->opcodes[info->eraseCmd[t]] : 0;
+        }
+        conflicts = s->bitConflicts;
+        report(pass ? "overwrite" : "rmw");
+        flashSPAN_Read(0, RdBuf, BENCH_SIZE);
+        sstSim_ClearStats();
+        printf("  updates    %lu erases, %lu bit conflicts, %u mismatches", (unsigned long)erases,
+                (unsigned long)conflicts, memcmp(RdBuf, shadow, BENCH_SIZE) ? 1 : 0);
+        if (pass)
+        {
+            printf(", %lu in place, %lu merged, %lu unchanged",
+                    (unsigned long)(o->inPlace - base.inPlace),
+                    (unsigned long)(o->merged - base.merged),
+                    (unsigned long)(o->unchanged - base.unchanged));
+        }
+        printf("\n");
+    }
+}
+#endif
+
+#if FLASH_ASYNC
+static flashSPAN_req_t AsyncReq[ASYNC_READS + 2];
+static uint64_t AsyncStart;
+static uint64_t AsyncLat[ASYNC_READS];
+
+// Records when each read of asyncMix() completed
+static void asyncDone(flashSPAN_req_t *req)
+{
+    if (req->op == FLASH_OP_READ)
+    {
+        AsyncLat[(uint16_t)(uintptr_t)req->context] = sstSim_Now() - AsyncStart;
+    }
+}
+
+// Print the average and worst read latency of asyncMix()
+static void asyncReport(const char *step)
+{
+    uint64_t sum = 0;
+    uint64_t worst = 0;
+    uint8_t i;
+
+    for (i = 0; i < ASYNC_READS; i++)
+    {
+        sum += AsyncLat[i];
+        if (AsyncLat[i] > worst)
+        {
+            worst = AsyncLat[i];
+        }
+    }
+    report(step);
+    printf("  reads      avg %.3f ms, worst %.3f ms\n", (sum / ASYNC_READS) / 1e6, worst / 1e6);
+}
+
+// Erase and rewrite block 0 while reading the last block of the volume: first with the blocking
+// functions in that order, then submitted all at once
+static void asyncMix(void)
+{
+    const flashSPAN_asyncStats_t *s;
+    uint32_t last = (flashSPAN.BlockCount - 1) * FLASH_VOLUME_BLOCKSIZE;
+    uint32_t elapsed;
+    uint8_t i;
+    uint8_t d;
+
+    sstSim_ClearStats();
+    AsyncStart = sstSim_Now();
+    flashSPAN_EraseBlock(0);
+    flashSPAN_Write(0, WrBuf, BENCH_SIZE);
+    for (i = 0; i < ASYNC_READS; i++)
+    {
+        flashSPAN_Read(last + (uint32_t)i * ASYNC_READ_SIZE, RdBuf, ASYNC_READ_SIZE);
+        AsyncLat[i] = sstSim_Now() - AsyncStart;
+    }
+    asyncReport("mix block");
+
+    AsyncReq[0].op = FLASH_OP_ERASE;
+    AsyncReq[0].address = 0;
+    AsyncReq[1].op = FLASH_OP_WRITE;
+    AsyncReq[1].address = 0;
+    AsyncReq[1].data = WrBuf;
+    AsyncReq[1].nBytes = BENCH_SIZE;
+    for (i = 0; i < ASYNC_READS; i++)
+    {
+        AsyncReq[i + 2].op = FLASH_OP_READ;
+        AsyncReq[i + 2].address = last + (uint32_t)i * ASYNC_READ_SIZE;
+        AsyncReq[i + 2].data = &RdBuf[i * ASYNC_READ_SIZE];
+        AsyncReq[i + 2].nBytes = ASYNC_READ_SIZE;
+        AsyncReq[i + 2].context = (void *)(uintptr_t)i;
+    }
+
+    flashSPAN_ClearAsyncStats();
+    sstSim_ClearStats();
+    AsyncStart = sstSim_Now();
+    for (i = 0; i < ASYNC_READS + 2; i++)
+    {
+        AsyncReq[i].callback = asyncDone;
+        flashSPAN_Submit(&AsyncReq[i]);
+    }
+    while (flashSPAN_Service());
+    asyncReport("mix async");
+
+    s = flashSPAN_GetAsyncStats();
+    elapsed = FLASH_ASYNC_CLOCK() - s->startTime;
+    printf("  queue      max depth %u, write %lu us, erase %lu us, busy", s->maxDepth,
+            (unsigned long)s->latencyMax[FLASH_OP_WRITE], (unsigned long)s->latencyMax[FLASH_OP_ERASE]);
+    for (d = 0; d < FLASH_DEVICECOUNT; d++)
+    {
+        printf(" %lu%%", (unsigned long)(elapsed ? (100ULL * s->busyTime[d]) / elapsed : 0));
+    }
+    flashSPAN_Read(0, RdBuf, BENCH_SIZE);
+    sstSim_ClearStats();
+    printf(", %u mismatches\n", memcmp(RdBuf, WrBuf, BENCH_SIZE) ? 1 : 0);
+}
+#endif
+
+#if SST_USE_SPI_QUEUE
+static uint8_t QueueDone;
+static uint64_t QueueStart;
+static uint64_t QueueEraseLat;
+
+// Counts the callbacks of queueErase() that come in order and times the first erase
+static void queueDone(spiTransaction_t *t)
+{
+    if ((uintptr_t)t->context == QueueDone)
+    {
+        QueueDone++;
+    }
+    if (QueueDone == 1)
+    {
+        QueueEraseLat = sstSim_Now() - QueueStart;
+    }
+}
+
+// Queues two 4 KB erases on device 0 and a read of the next 4 KB behind them without waiting in
+// between. The queued transactions have to wait for the device themselves.
+static void queueErase(void)
+{
+    const sst25vf_info_t *info;
+    uint8_t device = sst25vf_GetCurrentDevice();
+    uint8_t erased;
+    uint8_t i;
+
+    sst25vf_SetCurrentDevice(0);
+    info = sst25vf_GetInfo();
+    if (info->eraseCmd[SST_ETYPE_4K] == 0)
+    {
+        printf("  queue      skipped, no 4 KB erase\n");
+        sst25vf_SetCurrentDevice(device);
+        return;
+    }
+    for (i = 0; i < 3; i++)
+    {
+        sst25vf_EraseBlock(QUEUE_ADDR + i * 0x1000UL, 0x1000);
+        sst25vf_Write(QUEUE_ADDR + i * 0x1000UL, WrBuf, 0x1000);
+    }
+    memset(RdBuf, 0, 0x1000);
+
+    sstSim_ClearStats();
+    QueueDone = 0;
+    QueueStart = sstSim_Now();
+    sst25vf_xEraseAsync(QUEUE_ADDR, info->eraseCmd[SST_ETYPE_4K], queueDone, (void *)0);
+    sst25vf_xEraseAsync(QUEUE_ADDR + 0x1000, info->eraseCmd[SST_ETYPE_4K], queueDone, (void *)1);
+    sst25vf_ReadAsync(QUEUE_ADDR + 0x2000, RdBuf, 0x1000, queueDone, (void *)2);
+    spiQueueWait(SPI_BUS_DEFAULT);
+    report("queue");
+
+    erased = sst25vf_IsBlank(QUEUE_ADDR, 0x2000);
+    sstSim_ClearStats();
+    printf("  queue      %u of 3 callbacks in order, first erase done after %.3f ms, %s, "
+            "%u mismatches\n", QueueDone, QueueEraseLat / 1e6, erased ? "erased" : "not erased",
+            memcmp(RdBuf, WrBuf, 0x1000) ? 1 : 0);
+    sst25vf_SetCurrentDevice(device);
+}
+#endif
+
+///\endcond
+
+//--------------------------------------------------------------------------------------------------
+int main(void)
+{
+    sstSimType_t type;
+    const sst25vf_info_t *info;
+    uint16_t i;
+    uint16_t w;
+    uint32_t b;
+    uint64_t t;
+    uint8_t d;
+
+    for (i = 0; i < BENCH_SIZE; i++)
+    {
+        WrBuf[i] = (uint8_t)(i * 7 + (i >> 8));
+
+        // 16 byte records every 64 bytes, the rest left erased
+        SparseBuf[i] = ((i & 0x3F) < 16) ? WrBuf[i] : 0xFF;
+    }
+
+    printf("Modeled timing, %u device(s), SMCLK %lu Hz\n", FLASH_DEVICECOUNT,
+            (unsigned long)SPI_SMCLK_FREQ);
+
+    for (type = 0; type < SIM_TYPE_COUNT; type++)
+    {
+        sstSim_Init();
+        for (d = 0; d < FLASH_DEVICECOUNT; d++)
+        {
+            sstSim_AddDevice(SIM_CE(d), SIM_BUS(d), type);
+        }
+        printf("%s\n", sstSim_TypeName(type));
+
+        if (flashSPAN_Init() != RES_OK)
+        {
+            report("init");
+            printf("  init failed\n");
+            continue;
+        }
+        report("init");
+        sst25vf_SetCurrentDevice(0);
+        info = sst25vf_GetInfo();
+        printf("  geometry   page %u, program %u us, 4K erase %u ms, chip erase %u ms\n",
+                info->pageSize, info->progTimeUs, info->eraseTimeMs[SST_ETYPE_4K],
+                info->chipEraseMs);
+
+        flashSPAN_EraseAll();
+        report("erase all");
+
+        flashSPAN_Write(0, WrBuf, BENCH_SIZE);
+        report("write 4K");
+
+        memset(RdBuf, 0, BENCH_SIZE);
+        flashSPAN_Read(0, RdBuf, BENCH_SIZE);
+        report("read 4K");
+
+        w = 0;
+        for (i = 0; i < BENCH_SIZE; i++)
+        {
+            if (RdBuf[i] != WrBuf[i])
+            {
+                w++;
+            }
+        }
+        printf("  verify     %u mismatches\n", w);
+
+        sst25vf_SetCurrentDevice(0);
+        sst25vf_Read(0, DumpBuf, (uint32_t)flashSPAN.DeviceBlocks[0] * FLASH_BLOCKSIZE);
+        report("dump dev");
+
+        // Everything but the first and last block, once by range and once block by block
+        flashSPAN_EraseRange(FLASH_VOLUME_BLOCKSIZE, (flashSPAN.BlockCount - 2) * FLASH_VOLUME_BLOCKSIZE);
+        report("erase rng");
+        printf("  estimate   %lu ms, %lu ms saved\n",
+                (unsigned long)flashSPAN.LastEraseMs, (unsigned long)flashSPAN.LastEraseSavedMs);
+        for (b = 1; b < flashSPAN.BlockCount - 1; b++)
+        {
+            flashSPAN_EraseBlock(b);
+        }
+        report("erase blk");
+
+        backgroundErase();
+
+        t = sstSim_GetStats()->timeNs;
+        for (b = 0; b < APPEND_SIZE; b += BENCH_SIZE)
+        {
+            flashSPAN_Write(FLASH_VOLUME_BLOCKSIZE + b, WrBuf, BENCH_SIZE);
+        }
+        t = sstSim_GetStats()->timeNs - t;
+        report("append 64K");
+        w = 0;
+        for (b = 0; b < APPEND_SIZE; b += BENCH_SIZE)
+        {
+            flashSPAN_Read(FLASH_VOLUME_BLOCKSIZE + b, RdBuf, BENCH_SIZE);
+            w += memcmp(RdBuf, WrBuf, BENCH_SIZE) ? 1 : 0;
+        }
+        sstSim_ClearStats();
+        printf("  append     %.1f KB/s, %u mismatches\n", (APPEND_SIZE / 1024.0) / (t / 1e9), w);
+
+        // Sparse record data, written to an erased block and then once more unchanged
+        flashSPAN_EraseBlock(0);
+        report("erase 0");
+        flashSPAN_Write(0, SparseBuf, BENCH_SIZE);
+        report("sparse 4K");
+        flashSPAN_Write(0, SparseBuf, BENCH_SIZE);
+        report("rewrite 4K");
+        flashSPAN_Read(0, RdBuf, BENCH_SIZE);
+        sstSim_ClearStats();
+        printf("  verify     %u mismatches\n", memcmp(RdBuf, SparseBuf, BENCH_SIZE) ? 1 : 0);
+
+        // Header and payload of each record from separate buffers: two calls per record, then one
+        // vectored call for all of them. Read back into one buffer per record.
+        for (i = 0; i < REC_COUNT; i++)
+        {
+            RecIov[2 * i].data = &SparseBuf[i * REC_SIZE];
+            RecIov[2 * i].nBytes = REC_HDR_SIZE;
+            RecIov[2 * i + 1].data = &WrBuf[i * REC_SIZE + REC_HDR_SIZE];
+            RecIov[2 * i + 1].nBytes = REC_SIZE - REC_HDR_SIZE;
+            RecRdIov[i].data = &RdBuf[i * REC_SIZE];
+            RecRdIov[i].nBytes = REC_SIZE;
+        }
+        flashSPAN_EraseBlock(0);
+        sstSim_ClearStats();
+        for (i = 0, b = 0; i < REC_COUNT * 2; i++)
+        {
+            flashSPAN_Write(b, RecIov[i].data, RecIov[i].nBytes);
+            b += RecIov[i].nBytes;
+        }
+        report("rec write");
+        flashSPAN_EraseBlock(0);
+        sstSim_ClearStats();
+        flashSPAN_WriteV(0, RecIov, REC_COUNT * 2);
+        report("rec writev");
+        memset(RdBuf, 0, BENCH_SIZE);
+        flashSPAN_ReadV(0, RecRdIov, REC_COUNT);
+        report("rec readv");
+        w = 0;
+        for (i = 0; i < REC_COUNT * REC_SIZE; i++)
+        {
+            if (RdBuf[i] != (((i % REC_SIZE) < REC_HDR_SIZE) ? SparseBuf[i] : WrBuf[i]))
+            {
+                w++;
+            }
+        }
+        printf("  verify     %u mismatches\n", w);
+
+#if FLASH_CACHE_LINES
+        metaReads();
+#endif
+#if FLASH_OVERWRITE
+        overwrites();
+#endif
+        if ((FTL_FIRST_BLOCK + FTL_BLOCKS) > flashSPAN.BlockCount)
+        {
+            printf("  ftl        skipped, volume smaller than the FTL\n");
+        }
+        else
+        {
+            ftlEndurance();
+            ftlPowerLoss();
+#if FLASH_OVERWRITE && (FTL_FIRST_BLOCK == 0)
+            rawEndurance();
+#endif
+        }
+        logStore();
+#if FLASH_ASYNC
+        asyncMix();
+#endif
+#if SST_USE_SPI_QUEUE
+        queueErase();
+#endif
+    }
+
+    return(0);
+}
+
+#endif // __MSP430__
+
+///\}
@@ -44,67 +44,454 @@
 
 #include <stdint.h>
 
+#ifdef __MSP430__ // Host builds use spi_sim.c instead
+
 //#include "msp430_xc.h"
 #include <msp430.h>
 #include "spi.h"
 #include "spi_internal.h"
 
 
+///\cond INTERNAL
+
+#define _SPI_BUS_INIT(usci, psel, pins, pin, somi, idx, rxch, txch, rxtrig, txtrig) \
+    {SPI_USCI(usci, REGS), &(psel), (pins), &(pin), (somi), (idx), ((usci) < 4), \
+     (rxch), (txch), (rxtrig), (txtrig)}
+
+#if SPI_USE_DMA
+#define SPI_BUS_INIT(usci, psel, pins, pin, somi, idx, rxch, txch) \
+    _SPI_BUS_INIT(usci, psel, pins, pin, somi, idx, rxch, txch, \
+                  SPI_USCI(usci, DMA_RX_TRIG), SPI_USCI(usci, DMA_TX_TRIG))
+#else
+#define SPI_BUS_INIT(usci, psel, pins, pin, somi, idx, rxch, txch) \
+    _SPI_BUS_INIT(usci, psel, pins, pin, somi, idx, SPI_DMA_NONE, SPI_DMA_NONE, 0, 0)
+#endif
+
+///\endcond
+
+spiBus_t spiBus[SPI_BUS_COUNT] =
+{
+    SPI_BUS_INIT(SPI_USE_USCI, SPI_PSEL, SPI_PINS, SPI_SOMI_PIN, SOMI, 0,
+                 SPI_DMA_RX_CH, SPI_DMA_TX_CH),
+#if SPI_BUS_COUNT > 1
+    SPI_BUS_INIT(SPI_BUS1_USCI, SPI_BUS1_PSEL, SPI_BUS1_PINS, SPI_BUS1_SOMI_PIN, SPI_BUS1_SOMI_BIT, 1,
+                 SPI_BUS1_DMA_RX_CH, SPI_BUS1_DMA_TX_CH),
+#endif
+};
+
+///\cond INTERNAL
+
+// One pipelined read step: queue the next dummy byte, then collect the byte that was in flight.
+// Reading RXBUF clears UCOE, so the status is gathered before each read.
+#define READ_STEP(p)    do { \
+        while ((SPI_UCIFG(bus) & UCTXIFG) == 0); \
+        SPI_UCTXBUF(bus) = DUMMY_CHAR; \
+        while ((SPI_UCIFG(bus) & UCRXIFG) == 0); \
+        stat |= SPI_UCSTAT(bus); \
+        *(p)++ = SPI_UCRXBUF(bus); \
+    } while (0)
+
+// One pipelined write step: refill TXBUF as soon as it has been moved to the shift register
+#define SEND_STEP(p)    do { \
+        while ((SPI_UCIFG(bus) & UCTXIFG) == 0); \
+        SPI_UCTXBUF(bus) = *(p)++; \
+    } while (0)
+
+#if SPI_USE_DMA
+static const uint8_t DummyTx = DUMMY_CHAR;
+static uint8_t DummyRx;
+
+// Bus that owns each DMA receive channel. Used to dispatch the DMA interrupt.
+static spiBus_t *DmaOwner[SPI_DMA_MAX_CH];
+
 //--------------------------------------------------------------------------------------------------
-void spiInit(uint8_t spi_mode)
+static void dmaStart(spiBus_t *bus, uint8_t* pRx, uint16_t rxIncr, const uint8_t* pTx,
+                        uint16_t txIncr, uint16_t size)
 {
-	P4SEL |= SOMI + SIMO + SCLK; 	// P4.2,1,3 use special function
-	P4DIR |= CE; 					//Set P4.0 Gpio as chip enable
-	P4OUT |= CE;
+    volatile uint8_t x;
+    uint8_t rx = bus->dmaRx;
+    uint8_t tx = bus->dmaTx;
+
+    // Receive channel: RXBUF -> pRx
+    SPI_DMA_CTL(rx) = 0;
+    __data16_write_addr((unsigned short)&SPI_DMA_SA(rx), (unsigned long)&SPI_UCRXBUF(bus));
+    __data16_write_addr((unsigned short)&SPI_DMA_DA(rx), (unsigned long)pRx);
+    SPI_DMA_SZ(rx) = size;
+
+    // Transmit channel: pTx -> TXBUF. The first byte is written manually below since the TXIFG
+    // edge that triggers the DMA has already happened.
+    SPI_DMA_CTL(tx) = 0;
+    __data16_write_addr((unsigned short)&SPI_DMA_SA(tx), (unsigned long)(txIncr ? pTx + 1 : pTx));
+    __data16_write_addr((unsigned short)&SPI_DMA_DA(tx), (unsigned long)&SPI_UCTXBUF(bus));
+    SPI_DMA_SZ(tx) = size - 1;
+
+    x = SPI_UCRXBUF(bus); // discard any stale byte so the RX trigger starts clean
+
+    SPI_DMA_CTL(rx) = DMADT_0 + DMASRCINCR_0 + rxIncr + DMASRCBYTE + DMADSTBYTE + DMAEN
+                        + ((bus->callback) ? DMAIE : 0);
+    if (size > 1)
+    {
+        SPI_DMA_CTL(tx) = DMADT_0 + txIncr + DMADSTINCR_0 + DMASRCBYTE + DMADSTBYTE + DMAEN;
+    }
 
-    SPI_UCCTL1 |= UCSWRST;
-    SPI_UCCTL0 = spi_mode + UCMSB + UCMST + UCSYNC;
-    SPI_UCCTL1 = (SPI_CLK_SRC << 6) + UCSWRST;
-    SPI_UCBR = SPI_CLK_DIV;
-#if(SPI_USE_USCI < 4)
-    SPI_UCMCTL = 0;
+    SPI_UCTXBUF(bus) = *pTx;
+}
+
+//--------------------------------------------------------------------------------------------------
+static void dmaSetTrigger(uint8_t ch, uint8_t trig)
+{
+    uint8_t shift = SPI_DMA_TSEL_SHIFT(ch);
+    SPI_DMA_TSEL(ch) = (SPI_DMA_TSEL(ch) & ~(0x1F << shift)) | ((uint16_t)trig << shift);
+}
 #endif
-    SPI_UCCTL1 &= ~UCSWRST;
+
+//--------------------------------------------------------------------------------------------------
+// Start an interrupt-driven background frame
+static void irqStart(spiBus_t *bus, uint8_t* pRx, const uint8_t* pTx, uint16_t size)
+{
+    bus->pRx = pRx;
+    bus->pTx = (pTx) ? pTx + 1 : 0;
+    bus->count = size;
+    bus->busy = 1;
+    SPI_UCIE(bus) |= UCRXIE;
+    SPI_UCTXBUF(bus) = (pTx) ? *pTx : DUMMY_CHAR;
 }
 
 //--------------------------------------------------------------------------------------------------
-void spiUninit(void)
+// Service RXIFG of an interrupt-driven background frame
+static void irqService(spiBus_t *bus)
 {
-    SPI_UCCTL1 |= UCSWRST;
+    uint8_t rx;
+
+    rx = SPI_UCRXBUF(bus);
+    if (bus->pRx)
+    {
+        *bus->pRx++ = rx;
+    }
+
+    if (--bus->count)
+    {
+        SPI_UCTXBUF(bus) = (bus->pTx) ? *bus->pTx++ : DUMMY_CHAR;
+    }
+    else
+    {
+        SPI_UCIE(bus) &= ~UCRXIE;
+        bus->busy = 0;
+        if (bus->callback)
+        {
+            bus->callback(bus);
+        }
+    }
 }
+///\endcond
 
 //--------------------------------------------------------------------------------------------------
-uint8_t spiSendByte(uint8_t data)
+void spiBusInit(spiBus_t *bus, uint8_t spi_mode)
 {
-    SPI_UCTXBUF = data;    // write
-    while ((SPI_UCIFG & UCRXIFG) == 0); // wait for transfer to complete
-    return(SPI_UCRXBUF);
+    *bus->pSel |= bus->pins;
+
+    SPI_UCCTL1(bus) |= UCSWRST;
+    SPI_UCCTL0(bus) = spi_mode + UCMSB + UCMST + UCSYNC;
+    SPI_UCCTL1(bus) = (SPI_CLK_SRC << 6) + UCSWRST;
+    SPI_UCBR(bus) = SPI_CLK_DIV;
+    if (bus->usciA)
+    {
+        SPI_UCMCTL(bus) = 0;
+    }
+    SPI_UCCTL1(bus) &= ~UCSWRST;
+
+    bus->profile.clkSrc = SPI_CLK_SRC;
+    bus->profile.mode = spi_mode;
+    bus->profile.clkDiv = SPI_CLK_DIV;
+    bus->busy = 0;
+
+#if SPI_USE_DMA
+    if (spiBusHasDMA(bus))
+    {
+        SPI_DMA_CTL(bus->dmaRx) = 0;
+        SPI_DMA_CTL(bus->dmaTx) = 0;
+        dmaSetTrigger(bus->dmaRx, bus->dmaRxTrig);
+        dmaSetTrigger(bus->dmaTx, bus->dmaTxTrig);
+        DmaOwner[bus->dmaRx] = bus;
+        DMACTL4 = DMARMWDIS; // Don't let the DMA interrupt read-modify-write instructions
+    }
+#endif
+}
+
+//--------------------------------------------------------------------------------------------------
+void spiBusUninit(spiBus_t *bus)
+{
+#if SPI_USE_DMA
+    if (spiBusHasDMA(bus))
+    {
+        SPI_DMA_CTL(bus->dmaRx) = 0;
+        SPI_DMA_CTL(bus->dmaTx) = 0;
+    }
+#endif
+    SPI_UCIE(bus) &= ~UCRXIE;
+    SPI_UCCTL1(bus) |= UCSWRST;
+}
+
+//--------------------------------------------------------------------------------------------------
+void spiBusSetProfile(spiBus_t *bus, const spiProfile_t *profile)
+{
+    if ((profile->clkSrc == bus->profile.clkSrc) && (profile->mode == bus->profile.mode)
+            && (profile->clkDiv == bus->profile.clkDiv))
+    {
+        return;
+    }
+
+    SPI_UCCTL1(bus) |= UCSWRST;
+    SPI_UCCTL0(bus) = profile->mode + UCMSB + UCMST + UCSYNC;
+    SPI_UCCTL1(bus) = (profile->clkSrc << 6) + UCSWRST;
+    SPI_UCBR(bus) = profile->clkDiv;
+    SPI_UCCTL1(bus) &= ~UCSWRST;
+
+    bus->profile = *profile;
 }
 
 //--------------------------------------------------------------------------------------------------
-void spiReadFrame(uint8_t* pBuffer, uint16_t size)
+void spiMakeProfile(spiProfile_t *profile, uint32_t maxHz, uint8_t spi_mode)
 {
-    uint16_t i = 0;
-    for (i = 0; i < size; i++)
+    uint32_t div;
+
+    div = (SPI_SMCLK_FREQ + maxHz - 1) / maxHz;
+    if (div < SPI_CLK_DIV_MIN)
     {
-        SPI_UCTXBUF = DUMMY_CHAR;     // dummy write
-        while ((SPI_UCIFG & UCRXIFG) == 0); // wait for transfer to complete
-        pBuffer[i] = SPI_UCRXBUF;
+        div = SPI_CLK_DIV_MIN;
     }
+    if (div > 0xFFFF)
+    {
+        div = 0xFFFF;
+    }
+
+    profile->clkSrc = 2;
+    profile->mode = spi_mode;
+    profile->clkDiv = div;
+}
+
+//--------------------------------------------------------------------------------------------------
+uint32_t spiProfileClock(const spiProfile_t *profile)
+{
+    uint32_t src = (profile->clkSrc == 1) ? SPI_ACLK_FREQ : SPI_SMCLK_FREQ;
+    return(src / profile->clkDiv);
+}
+
+//--------------------------------------------------------------------------------------------------
+uint8_t spiBusSOMILevel(spiBus_t *bus)
+{
+    // The input buffer follows the pin while it is selected for the USCI
+    return((*bus->pIn & bus->somi) ? 1 : 0);
+}
+
+//--------------------------------------------------------------------------------------------------
+uint8_t spiBusSendByte(spiBus_t *bus, uint8_t data)
+{
+    SPI_UCTXBUF(bus) = data;    // write
+    while ((SPI_UCIFG(bus) & UCRXIFG) == 0); // wait for transfer to complete
+    return(SPI_UCRXBUF(bus));
 }
 
 //--------------------------------------------------------------------------------------------------
-void spiSendFrame(const uint8_t* pBuffer, uint16_t size)
+void spiBusReadFrame(spiBus_t *bus, uint8_t* pBuffer, uint16_t size)
 {
-    uint16_t i = 0;
+    uint16_t gie = __get_SR_register() & GIE;
+    uint8_t stat = 0;
+    uint16_t n;
+
+    if (size == 0)
+    {
+        return;
+    }
+
+#if SPI_USE_DMA
+    if ((size >= SPI_DMA_MIN_FRAME) && spiBusHasDMA(bus))
+    {
+        spiBusStartReadFrame(bus, pBuffer, size, 0);
+        spiBusWaitFrame(bus);
+        return;
+    }
+#endif
+
+    // Keep TXBUF one byte ahead of the shift register so that the bus never idles between bytes.
+    // The next dummy byte is queued before the previous byte is collected from RXBUF. A byte takes
+    // as little as 16 MCLK cycles, less than any ISR, so an interrupt inside a step would let the
+    // queued byte overrun RXBUF. Interrupts are held off for each burst of steps and let in between
+    // bursts, when only one byte is in flight.
+    SPI_UCTXBUF(bus) = DUMMY_CHAR;
+    n = size - 1;
+
+    while (n >= 4)
+    {
+        __disable_interrupt();
+        __no_operation();
+        READ_STEP(pBuffer);
+        READ_STEP(pBuffer);
+        READ_STEP(pBuffer);
+        READ_STEP(pBuffer);
+        __bis_SR_register(gie);
+        __no_operation();
+        n -= 4;
+    }
+    __disable_interrupt();
+    __no_operation();
+    while (n)
+    {
+        READ_STEP(pBuffer);
+        n--;
+    }
+    __bis_SR_register(gie);
+
+    while ((SPI_UCIFG(bus) & UCRXIFG) == 0); // collect the last byte
+    stat |= SPI_UCSTAT(bus);
+    *pBuffer = SPI_UCRXBUF(bus);
+
+    if (stat & UCOE)
+    {
+        bus->overruns++;
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+void spiBusSendFrame(spiBus_t *bus, const uint8_t* pBuffer, uint16_t size)
+{
+    uint16_t n;
     volatile uint8_t x;
-    for (i = 0; i < size; i++)
+
+    if (size == 0)
+    {
+        return;
+    }
+
+#if SPI_USE_DMA
+    if ((size >= SPI_DMA_MIN_FRAME) && spiBusHasDMA(bus))
+    {
+        spiBusStartSendFrame(bus, pBuffer, size, 0);
+        spiBusWaitFrame(bus);
+        return;
+    }
+#endif
+
+    n = size;
+    while (n >= 4)
+    {
+        SEND_STEP(pBuffer);
+        SEND_STEP(pBuffer);
+        SEND_STEP(pBuffer);
+        SEND_STEP(pBuffer);
+        n -= 4;
+    }
+    while (n)
+    {
+        SEND_STEP(pBuffer);
+        n--;
+    }
+
+    while (SPI_UCSTAT(bus) & UCBUSY); // wait for transfer to complete
+    x = SPI_UCRXBUF(bus); // dummy read to clear the rx flag
+}
+
+//--------------------------------------------------------------------------------------------------
+void spiBusStartReadFrame(spiBus_t *bus, uint8_t* pBuffer, uint16_t size, spiCallback_t callback)
+{
+    bus->callback = callback;
+#if SPI_USE_DMA
+    if (spiBusHasDMA(bus))
+    {
+        dmaStart(bus, pBuffer, DMADSTINCR_3, &DummyTx, DMASRCINCR_0, size);
+        return;
+    }
+#endif
+    irqStart(bus, pBuffer, 0, size);
+}
+
+//--------------------------------------------------------------------------------------------------
+void spiBusStartSendFrame(spiBus_t *bus, const uint8_t* pBuffer, uint16_t size, spiCallback_t callback)
+{
+    bus->callback = callback;
+#if SPI_USE_DMA
+    if (spiBusHasDMA(bus))
     {
-        SPI_UCTXBUF = pBuffer[i];
-        while ((SPI_UCIFG & UCTXIFG) == 0); // wait for tx buffer to be ready
+        // Received bytes are drained into a dummy location so that completion of the receive
+        // channel marks the point where the last byte has been fully shifted out.
+        dmaStart(bus, &DummyRx, DMADSTINCR_0, pBuffer, DMASRCINCR_3, size);
+        return;
+    }
+#endif
+    irqStart(bus, 0, pBuffer, size);
+}
+
+//--------------------------------------------------------------------------------------------------
+uint8_t spiBusFrameBusy(spiBus_t *bus)
+{
+#if SPI_USE_DMA
+    if (spiBusHasDMA(bus))
+    {
+        // DMAEN is cleared by hardware once the receive channel has transferred the last byte
+        return((SPI_DMA_CTL(bus->dmaRx) & DMAEN) ? 1 : 0);
+    }
+#endif
+    return(bus->busy);
+}
+
+//--------------------------------------------------------------------------------------------------
+void spiBusWaitFrame(spiBus_t *bus)
+{
+    while (spiBusFrameBusy(bus));
+}
+
+#if SPI_USE_DMA
+//--------------------------------------------------------------------------------------------------
+/**
+* \brief DMA interrupt. Signals completion of a background frame transfer.
+* \attention This occupies the shared DMA vector. Other users of the DMA must be serviced here.
+**/
+#pragma vector=DMA_VECTOR
+__interrupt void spi_DMA_ISR(void)
+{
+    uint16_t iv;
+    spiBus_t *bus;
+
+    iv = __even_in_range(DMAIV, 16);
+    if (iv)
+    {
+        bus = DmaOwner[(iv >> 1) - 1];
+        if (bus && bus->callback)
+        {
+            bus->callback(bus);
+        }
+    }
+}
+#endif
+
+//--------------------------------------------------------------------------------------------------
+/**
+* \brief USCI interrupt of bus 0. Moves one byte of a background frame transfer per RXIFG.
+**/
+#pragma vector=SPI_USCI(SPI_USE_USCI, VECTOR)
+__interrupt void spi_Bus0_ISR(void)
+{
+    if (__even_in_range(SPI_UCIV(&spiBus[0]), 4) == 2) // RXIFG
+    {
+        irqService(&spiBus[0]);
     }
-    while ((SPI_UCSTAT & UCBUSY) == 0); // wait for transfer to complete
-    x = SPI_UCRXBUF; // dummy read to clear the rx flag
 }
 
+#if SPI_BUS_COUNT > 1
+//--------------------------------------------------------------------------------------------------
+/**
+* \brief USCI interrupt of bus 1
+**/
+#pragma vector=SPI_USCI(SPI_BUS1_USCI, VECTOR)
+__interrupt void spi_Bus1_ISR(void)
+{
+    if (__even_in_range(SPI_UCIV(&spiBus[1]), 4) == 2) // RXIFG
+    {
+        irqService(&spiBus[1]);
+    }
+}
+#endif
+
+#endif // __MSP430__
+
 ///\}
@@ -57,6 +57,7 @@
 extern "C" {
 #endif
 
+#include <stdint.h>
 #include "spi_config.h"
 
 //==================================================================================================
@@ -75,51 +76,232 @@ extern "C" {
 #define SPI_MODE3    (0+UCCKPL)         ///< \brief CPOL = 1, CPHA = 1 \hideinitializer
 ///\}
 
+/// DMA channel value meaning "no channel assigned"
+#define SPI_DMA_NONE    0xFF
+
+/// Bus used by the legacy single-bus functions (spiInit(), spiSendByte(), ...)
+#define SPI_BUS_DEFAULT    (&spiBus[0])
+
+/// Evaluates to nonzero if a bus can transfer frames by DMA
+#define spiBusHasDMA(bus)    ((bus)->dmaTx != SPI_DMA_NONE)
+
+//==================================================================================================
+// Types
+//==================================================================================================
+
+    ///\brief Bus profile. Describes the clocking of the SPI controller for a particular device.
+    typedef struct
+    {
+        uint8_t clkSrc;     ///< 1 = ACLK, 2 = SMCLK
+        uint8_t mode;       ///< One of the \c SPI_MODEx modes
+        uint16_t clkDiv;    ///< Clock division
+    } spiProfile_t;
+
+    typedef struct spiBus_s spiBus_t;
+
+    /**
+    * \brief Callback that is executed when an asynchronous frame transfer completes
+    * \param [in] bus Bus on which the transfer completed
+    * \attention Callbacks are called from within an interrupt service routine
+    **/
+    typedef void (*spiCallback_t)(spiBus_t *bus);
+
+    /**
+    * \brief SPI bus instance
+    *
+    * One object exists per USCI module in use (see #SPI_BUS_COUNT). The configuration members are
+    * set up from spi_config.h. Each bus has its own profile and background transfer state, so
+    * transfers on different buses can run at the same time.
+    **/
+    struct spiBus_s
+    {
+        // Configuration
+        volatile uint8_t *regs;     ///< USCI module registers
+        volatile uint8_t *pSel;     ///< Port select register of the bus pins
+        uint8_t pins;               ///< Bus pin mask (SIMO, SOMI, SCLK)
+        volatile const uint8_t *pIn; ///< Port input register of the SOMI pin
+        uint8_t somi;               ///< SOMI pin mask
+        uint8_t index;              ///< Index in #spiBus
+        uint8_t usciA;              ///< 1 if the bus is a USCI_A module (has a UCxMCTL register)
+        uint8_t dmaRx;              ///< DMA channel that empties RXBUF or #SPI_DMA_NONE
+        uint8_t dmaTx;              ///< DMA channel that feeds TXBUF or #SPI_DMA_NONE
+        uint8_t dmaRxTrig;          ///< DMA trigger for RXIFG
+        uint8_t dmaTxTrig;          ///< DMA trigger for TXIFG
+
+        // State
+        spiProfile_t profile;       ///< \private Active profile
+        spiCallback_t callback;     ///< \private Background transfer callback
+        volatile uint8_t busy;      ///< \private Interrupt-driven transfer in progress
+        uint8_t *pRx;               ///< \private
+        const uint8_t *pTx;         ///< \private
+        uint16_t count;             ///< \private
+        uint16_t overruns;          ///< Polled reads in which RXBUF overran and a byte was lost
+    };
+
+///\brief Bus instances
+    extern spiBus_t spiBus[SPI_BUS_COUNT];
+
 //==================================================================================================
 // Function Prototypes
 //==================================================================================================
 
     /**
-    * \brief Initializes the SPI controller
+    * \brief Initializes an SPI bus
+    * \param [in] bus Bus to initialize
     * \param [in] spi_mode The SPI mode the controller will operate in
-    * \attention The initialization routine does \e not setup the IO ports!
+    * \attention Only the pins of the bus itself are set up. Chip enables are not.
     **/
-    void spiInit(uint8_t spi_mode);
+    void spiBusInit(spiBus_t *bus, uint8_t spi_mode);
 
     /**
-    * \brief Uninitializes the SPI controller
+    * \brief Uninitializes an SPI bus
     **/
-    void spiUninit(void);
+    void spiBusUninit(spiBus_t *bus);
+
+    /**
+    * \brief Switches the bus to a different profile
+    * \param [in] bus Bus to reconfigure
+    * \param [in] profile Profile to switch to
+    *
+    * Does nothing if the profile is already active. Must not be called while a transfer is in
+    * progress.
+    **/
+    void spiBusSetProfile(spiBus_t *bus, const spiProfile_t *profile);
+
+    /**
+    * \brief Builds the fastest profile that does not exceed a given bus clock
+    * \param [out] profile Profile to fill in
+    * \param [in] maxHz Highest SPI clock frequency the device supports
+    * \param [in] spi_mode SPI mode of the device
+    *
+    * Uses SMCLK as source with the smallest division of at least #SPI_CLK_DIV_MIN that keeps the
+    * bus clock at or below \c maxHz.
+    **/
+    void spiMakeProfile(spiProfile_t *profile, uint32_t maxHz, uint8_t spi_mode);
+
+    /**
+    * \brief Get the bus clock frequency of a profile
+    * \param [in] profile Profile to evaluate
+    * \return SPI clock in Hz, based on #SPI_ACLK_FREQ and #SPI_SMCLK_FREQ
+    **/
+    uint32_t spiProfileClock(const spiProfile_t *profile);
+
+    /**
+    * \brief Get the level of the SOMI pin without clocking the bus
+    * \param [in] bus Bus to sample
+    * \retval 0 Low
+    * \retval 1 High
+    *
+    * Used to read a busy signal that a slave drives on its data output while it is selected, such
+    * as the RY/BY# output of SST25VF devices.
+    **/
+    uint8_t spiBusSOMILevel(spiBus_t *bus);
 
     /**
     * \brief Sends [and receives] a single byte
+    * \param [in] bus Bus to use
     * \param [in] data Byte to be sent
     * \retval uint8_t Byte received
     **/
-    uint8_t spiSendByte(uint8_t data);
+    uint8_t spiBusSendByte(spiBus_t *bus, uint8_t data);
 
     /**
     * \brief Read a series of bytes from the SPI slave
+    * \param [in] bus Bus to use
     * \param [in] size Number of bytes to read
     * \param [out] pBuffer Data read
+    *
+    * Frames that lose a byte to an RXBUF overrun are counted in spiBus_s::overruns.
     **/
-    void spiReadFrame(uint8_t* pBuffer, uint16_t size);
+    void spiBusReadFrame(spiBus_t *bus, uint8_t* pBuffer, uint16_t size);
 
     /**
     * \brief Write a series of bytes to the SPI slave
+    * \param [in] bus Bus to use
     * \param [in] size Number of bytes to write
     * \param [in] pBuffer Data to be written
     **/
-    void spiSendFrame(const uint8_t* pBuffer, uint16_t size);
+    void spiBusSendFrame(spiBus_t *bus, const uint8_t* pBuffer, uint16_t size);
+
+    /**
+    * \brief Start reading a series of bytes from the SPI slave in the background
+    * \param [in] bus Bus to use
+    * \param [in] size Number of bytes to read. Must be at least 1
+    * \param [out] pBuffer Data read. Must remain valid until the transfer completes
+    * \param [in] callback Called once the last byte has been received. Can be \c NULL.
+    *
+    * The transfer is performed by the DMA controller if the bus has DMA channels assigned,
+    * otherwise by the USCI interrupt (interrupts must then be enabled). Use spiBusFrameBusy() or
+    * spiBusWaitFrame() to determine when it has completed. No other function may be called on
+    * this bus until then.
+    **/
+    void spiBusStartReadFrame(spiBus_t *bus, uint8_t* pBuffer, uint16_t size, spiCallback_t callback);
+
+    /**
+    * \brief Start writing a series of bytes to the SPI slave in the background
+    * \param [in] bus Bus to use
+    * \param [in] size Number of bytes to write. Must be at least 1
+    * \param [in] pBuffer Data to be written. Must remain valid until the transfer completes
+    * \param [in] callback Called once the last byte has been shifted out. Can be \c NULL.
+    *
+    * See spiBusStartReadFrame().
+    **/
+    void spiBusStartSendFrame(spiBus_t *bus, const uint8_t* pBuffer, uint16_t size, spiCallback_t callback);
+
+    /**
+    * \brief Check whether a background frame transfer is still in progress
+    * \retval 0 Idle
+    * \retval 1 Busy
+    **/
+    uint8_t spiBusFrameBusy(spiBus_t *bus);
+
+    /**
+    * \brief Block until the background frame transfer has completed
+    **/
+    void spiBusWaitFrame(spiBus_t *bus);
 
 #if !defined(__DOXYGEN__)
-#define spiGetByte()    spiSendByte(DUMMY_CHAR)
+#define spiInit(m)                      spiBusInit(SPI_BUS_DEFAULT, (m))
+#define spiUninit()                     spiBusUninit(SPI_BUS_DEFAULT)
+#define spiSetProfile(p)                spiBusSetProfile(SPI_BUS_DEFAULT, (p))
+#define spiSendByte(d)                  spiBusSendByte(SPI_BUS_DEFAULT, (d))
+#define spiReadFrame(b, n)              spiBusReadFrame(SPI_BUS_DEFAULT, (b), (n))
+#define spiSendFrame(b, n)              spiBusSendFrame(SPI_BUS_DEFAULT, (b), (n))
+#define spiStartReadFrame(b, n, c)      spiBusStartReadFrame(SPI_BUS_DEFAULT, (b), (n), (c))
+#define spiStartSendFrame(b, n, c)      spiBusStartSendFrame(SPI_BUS_DEFAULT, (b), (n), (c))
+#define spiFrameBusy()                  spiBusFrameBusy(SPI_BUS_DEFAULT)
+#define spiWaitFrame()                  spiBusWaitFrame(SPI_BUS_DEFAULT)
+#define spiGetByte()                    spiSendByte(DUMMY_CHAR)
+#define spiBusGetByte(bus)              spiBusSendByte((bus), DUMMY_CHAR)
 #else
+    /**
+    * \name Single-bus functions
+    * \brief Equivalents of the spiBusX() functions that operate on #SPI_BUS_DEFAULT
+    * \{
+    **/
+    void spiInit(uint8_t spi_mode);
+    void spiUninit(void);
+    void spiSetProfile(const spiProfile_t *profile);
+    uint8_t spiSendByte(uint8_t data);
+    void spiReadFrame(uint8_t* pBuffer, uint16_t size);
+    void spiSendFrame(const uint8_t* pBuffer, uint16_t size);
+    void spiStartReadFrame(uint8_t* pBuffer, uint16_t size, spiCallback_t callback);
+    void spiStartSendFrame(const uint8_t* pBuffer, uint16_t size, spiCallback_t callback);
+    uint8_t spiFrameBusy(void);
+    void spiWaitFrame(void);
+    ///\}
+
     /**
     * \brief Gets a byte from the SPI device
     * \retval Byte received
     **/
     uint8_t spiGetByte(void);
+
+    /**
+    * \brief Gets a byte from the SPI device on a specific bus
+    * \retval Byte received
+    **/
+    uint8_t spiBusGetByte(spiBus_t *bus);
 #endif
 
 #ifdef __cplusplus
@@ -12,6 +12,8 @@
 #ifndef _SPI_CONFIG_H_
 #define _SPI_CONFIG_H_
 
+#include "clock.h"
+
 //==================================================================================================
 /// \name Configuration
 /// Configuration defines for the \ref MOD_SPI module
@@ -23,7 +25,14 @@
 //  ===================================================
 
 
-/// Select which USCI module to use
+/// Number of SPI bus instances. See spiBus_t.
+#define SPI_BUS_COUNT   1    ///< \hideinitializer
+
+//--------------------------------------------------------------------------------------------------
+// Bus 0 (SPI_BUS_DEFAULT)
+//--------------------------------------------------------------------------------------------------
+
+/// Select which USCI module to use for bus 0
 #define SPI_USE_USCI    5	 ///< \hideinitializer
 /**<    0 = USCIA0 \n
 *         1 = USCIA1 \n
@@ -35,6 +44,45 @@
 *         7 = USCIB3
 **/
 
+/// Port select register of the bus 0 pins
+#define SPI_PSEL        P4SEL   ///< \hideinitializer
+
+/// Input register of the bus 0 SOMI pin. Read by spiBusSOMILevel().
+#define SPI_SOMI_PIN    P4IN    ///< \hideinitializer
+
+/// DMA channel that empties the receive buffer of bus 0. Must be a lower number (higher priority)
+/// than #SPI_DMA_TX_CH so that a received byte is never overwritten.
+#define SPI_DMA_RX_CH      0 ///< \hideinitializer
+
+/// DMA channel that feeds the transmit buffer of bus 0
+#define SPI_DMA_TX_CH      1 ///< \hideinitializer
+
+//--------------------------------------------------------------------------------------------------
+// Bus 1
+//--------------------------------------------------------------------------------------------------
+
+/// Select which USCI module to use for bus 1
+#define SPI_BUS1_USCI      4           ///< \hideinitializer
+
+/// Port select register of the bus 1 pins
+#define SPI_BUS1_PSEL      P3SEL       ///< \hideinitializer
+
+/// Bus 1 pins (SIMO, SOMI, SCLK)
+#define SPI_BUS1_PINS      (BIT0 + BIT1 + BIT2) ///< \hideinitializer
+
+/// Input register and bit of the bus 1 SOMI pin
+#define SPI_BUS1_SOMI_PIN  P3IN        ///< \hideinitializer
+#define SPI_BUS1_SOMI_BIT  BIT1        ///< \hideinitializer
+
+/// DMA channels of bus 1. The F5529 only has three DMA channels, so by default bus 1 moves
+/// background frames from its USCI interrupt instead.
+#define SPI_BUS1_DMA_RX_CH SPI_DMA_NONE ///< \hideinitializer
+#define SPI_BUS1_DMA_TX_CH SPI_DMA_NONE ///< \hideinitializer
+
+//--------------------------------------------------------------------------------------------------
+// Common
+//--------------------------------------------------------------------------------------------------
+
 /// Select which clock source to use
 #define SPI_CLK_SRC        2 ///< \hideinitializer
 /**<    1 = ACLK    \n
@@ -44,15 +92,39 @@
 /// SPI Clock division. Must be 4 or greater
 #define SPI_CLK_DIV        2 //,4 ///< \hideinitializer
 
+/// Smallest clock division spiMakeProfile() will select
+#define SPI_CLK_DIV_MIN    2 ///< \hideinitializer
+
+/// ACLK frequency in Hz. Used by spiMakeProfile(). clockInit() runs ACLK from REFO.
+#define SPI_ACLK_FREQ      CLOCK_FLLREF_FREQ ///< \hideinitializer
+
+/// SMCLK frequency in Hz. Used by spiMakeProfile(). Follows the frequency clockInit() sets up, see
+/// \ref MOD_CLOCK "Clock Setup".
+#define SPI_SMCLK_FREQ     CLOCK_SMCLK_FREQ ///< \hideinitializer
+
 /// Byte that is transmitted during read operations
 #define DUMMY_CHAR    (0xFF)
 
+/// Use the DMA controller for frame transfers
+#define SPI_USE_DMA        1 ///< \hideinitializer
+/**<    0 = Frames are always transferred by polling \n
+*        1 = Frames of #SPI_DMA_MIN_FRAME bytes or more are transferred by DMA on buses that have
+*            both DMA channels assigned
+**/
+
+/// Frames shorter than this are transferred by polling. Setting up the DMA costs about as much as
+/// polling a handful of bytes.
+#define SPI_DMA_MIN_FRAME  8 ///< \hideinitializer
+
 
 #define SCLK BIT3 	//P4.3 master Clock out
 #define SOMI BIT2 	//P4.2 master in
 #define SIMO BIT1 	//P4.1 master out
 #define CE   BIT0 	//P4.0 Chip Enable line
 
+/// Bus 0 pins
+#define SPI_PINS    (SOMI + SIMO + SCLK) ///< \hideinitializer
+
 
 ///\}
 
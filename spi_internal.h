@@ -45,129 +45,116 @@
 #error "Invalid SPI_CLK_SRC in spi_config.h"
 #endif
 
+#if (SPI_BUS_COUNT < 1) || (SPI_BUS_COUNT > 2)
+#error "Invalid SPI_BUS_COUNT in spi_config.h"
+#endif
+
+//==================================================================================================
+// USCI register offsets from the start of the module (UCxCTL1)
+//==================================================================================================
+#define OFS_SPI_UCCTL1    0x00
+#define OFS_SPI_UCCTL0    0x01
+#define OFS_SPI_UCBR      0x06
+#define OFS_SPI_UCMCTL    0x08
+#define OFS_SPI_UCSTAT    0x0A
+#define OFS_SPI_UCRXBUF   0x0C
+#define OFS_SPI_UCTXBUF   0x0E
+#define OFS_SPI_UCIE      0x1C
+#define OFS_SPI_UCIFG     0x1D
+#define OFS_SPI_UCIV      0x1E
 
-#if SPI_USE_USCI == 0
+#define SPI_UCCTL1(bus)   ((bus)->regs[OFS_SPI_UCCTL1])
+#define SPI_UCCTL0(bus)   ((bus)->regs[OFS_SPI_UCCTL0])
+#define SPI_UCBR(bus)     (*(volatile uint16_t *)&(bus)->regs[OFS_SPI_UCBR])
+#define SPI_UCMCTL(bus)   ((bus)->regs[OFS_SPI_UCMCTL])
+#define SPI_UCSTAT(bus)   ((bus)->regs[OFS_SPI_UCSTAT])
+#define SPI_UCRXBUF(bus)  ((bus)->regs[OFS_SPI_UCRXBUF])
+#define SPI_UCTXBUF(bus)  ((bus)->regs[OFS_SPI_UCTXBUF])
+#define SPI_UCIE(bus)     ((bus)->regs[OFS_SPI_UCIE])
+#define SPI_UCIFG(bus)    ((bus)->regs[OFS_SPI_UCIFG])
+#define SPI_UCIV(bus)     (*(volatile uint16_t *)&(bus)->regs[OFS_SPI_UCIV])
+
+//==================================================================================================
+// Per-USCI definitions. Only modules present on the device are defined, so selecting a missing
+// module in spi_config.h fails to compile.
+//==================================================================================================
 #if defined(__MSP430_HAS_USCI_A0__)
-#define SPI_UCCTL0    UCA0CTL0
-#define SPI_UCCTL1    UCA0CTL1
-#define SPI_UCBR    UCA0BRW
-#define SPI_UCMCTL    UCA0MCTL
-#define SPI_UCSTAT    UCA0STAT
-#define SPI_UCRXBUF    UCA0RXBUF
-#define SPI_UCTXBUF    UCA0TXBUF
-#define SPI_UCIE    UCA0IE
-#define SPI_UCIFG    UCA0IFG
-#define SPI_UCIV    UCA0IV
-#else
-#error "Invalid SPI_USE_USCI in spi_config.h"
+#define SPI_USCI0_REGS          ((volatile uint8_t *)&UCA0CTL1)
+#define SPI_USCI0_VECTOR        USCI_A0_VECTOR
+#define SPI_USCI0_DMA_RX_TRIG   16  // UCA0RXIFG
+#define SPI_USCI0_DMA_TX_TRIG   17  // UCA0TXIFG
 #endif
-#elif SPI_USE_USCI == 1
 #if defined(__MSP430_HAS_USCI_A1__)
-#define SPI_UCCTL0    UCA1CTL0
-#define SPI_UCCTL1    UCA1CTL1
-#define SPI_UCBR    UCA1BRW
-#define SPI_UCMCTL    UCA1MCTL
-#define SPI_UCSTAT    UCA1STAT
-#define SPI_UCRXBUF    UCA1RXBUF
-#define SPI_UCTXBUF    UCA1TXBUF
-#define SPI_UCIE    UCA1IE
-#define SPI_UCIFG    UCA1IFG
-#define SPI_UCIV    UCA1IV
-#else
-#error "Invalid SPI_USE_USCI in spi_config.h"
+#define SPI_USCI1_REGS          ((volatile uint8_t *)&UCA1CTL1)
+#define SPI_USCI1_VECTOR        USCI_A1_VECTOR
+#define SPI_USCI1_DMA_RX_TRIG   20  // UCA1RXIFG
+#define SPI_USCI1_DMA_TX_TRIG   21  // UCA1TXIFG
 #endif
-#elif SPI_USE_USCI == 2
 #if defined(__MSP430_HAS_USCI_A2__)
-#define SPI_UCCTL0    UCA2CTL0
-#define SPI_UCCTL1    UCA2CTL1
-#define SPI_UCBR    UCA2BRW
-#define SPI_UCMCTL    UCA2MCTL
-#define SPI_UCSTAT    UCA2STAT
-#define SPI_UCRXBUF    UCA2RXBUF
-#define SPI_UCTXBUF    UCA2TXBUF
-#define SPI_UCIE    UCA2IE
-#define SPI_UCIFG    UCA2IFG
-#define SPI_UCIV    UCA2IV
-#else
-#error "Invalid SPI_USE_USCI in spi_config.h"
+#define SPI_USCI2_REGS          ((volatile uint8_t *)&UCA2CTL1)
+#define SPI_USCI2_VECTOR        USCI_A2_VECTOR
 #endif
-#elif SPI_USE_USCI == 3
 #if defined(__MSP430_HAS_USCI_A3__)
-#define SPI_UCCTL0    UCA3CTL0
-#define SPI_UCCTL1    UCA3CTL1
-#define SPI_UCBR    UCA3BRW
-#define SPI_UCMCTL    UCA3MCTL
-#define SPI_UCSTAT    UCA3STAT
-#define SPI_UCRXBUF    UCA3RXBUF
-#define SPI_UCTXBUF    UCA3TXBUF
-#define SPI_UCIE    UCA3IE
-#define SPI_UCIFG    UCA3IFG
-#define SPI_UCIV    UCA3IV
-#else
-#error "Invalid SPI_USE_USCI in spi_config.h"
+#define SPI_USCI3_REGS          ((volatile uint8_t *)&UCA3CTL1)
+#define SPI_USCI3_VECTOR        USCI_A3_VECTOR
 #endif
-#elif SPI_USE_USCI == 4
 #if defined(__MSP430_HAS_USCI_B0__)
-#define SPI_UCCTL0    UCB0CTL0
-#define SPI_UCCTL1    UCB0CTL1
-#define SPI_UCBR    UCB0BRW
-#define SPI_UCMCTL    UCB0MCTL
-#define SPI_UCSTAT    UCB0STAT
-#define SPI_UCRXBUF    UCB0RXBUF
-#define SPI_UCTXBUF    UCB0TXBUF
-#define SPI_UCIE    UCB0IE
-#define SPI_UCIFG    UCB0IFG
-#define SPI_UCIV    UCB0IV
-#else
-#error "Invalid SPI_USE_USCI in spi_config.h"
+#define SPI_USCI4_REGS          ((volatile uint8_t *)&UCB0CTL1)
+#define SPI_USCI4_VECTOR        USCI_B0_VECTOR
+#define SPI_USCI4_DMA_RX_TRIG   18  // UCB0RXIFG
+#define SPI_USCI4_DMA_TX_TRIG   19  // UCB0TXIFG
 #endif
-#elif SPI_USE_USCI == 5
 #if defined(__MSP430_HAS_USCI_B1__)
-#define SPI_UCCTL0    UCB1CTL0
-#define SPI_UCCTL1    UCB1CTL1
-#define SPI_UCBR    UCB1BRW
-#define SPI_UCMCTL    UCB1MCTL
-#define SPI_UCSTAT    UCB1STAT
-#define SPI_UCRXBUF    UCB1RXBUF
-#define SPI_UCTXBUF    UCB1TXBUF
-#define SPI_UCIE    UCB1IE
-#define SPI_UCIFG    UCB1IFG
-#define SPI_UCIV    UCB1IV
-#else
-#error "Invalid SPI_USE_USCI in spi_config.h"
+#define SPI_USCI5_REGS          ((volatile uint8_t *)&UCB1CTL1)
+#define SPI_USCI5_VECTOR        USCI_B1_VECTOR
+#define SPI_USCI5_DMA_RX_TRIG   22  // UCB1RXIFG
+#define SPI_USCI5_DMA_TX_TRIG   23  // UCB1TXIFG
 #endif
-#elif SPI_USE_USCI == 6
 #if defined(__MSP430_HAS_USCI_B2__)
-#define SPI_UCCTL0    UCB2CTL0
-#define SPI_UCCTL1    UCB2CTL1
-#define SPI_UCBR    UCB2BRW
-#define SPI_UCMCTL    UCB2MCTL
-#define SPI_UCSTAT    UCB2STAT
-#define SPI_UCRXBUF    UCB2RXBUF
-#define SPI_UCTXBUF    UCB2TXBUF
-#define SPI_UCIE    UCB2IE
-#define SPI_UCIFG    UCB2IFG
-#define SPI_UCIV    UCB2IV
-#else
-#error "Invalid SPI_USE_USCI in spi_config.h"
+#define SPI_USCI6_REGS          ((volatile uint8_t *)&UCB2CTL1)
+#define SPI_USCI6_VECTOR        USCI_B2_VECTOR
 #endif
-#elif SPI_USE_USCI == 7
 #if defined(__MSP430_HAS_USCI_B3__)
-#define SPI_UCCTL0    UCB3CTL0
-#define SPI_UCCTL1    UCB3CTL1
-#define SPI_UCBR    UCB3BRW
-#define SPI_UCMCTL    UCB3MCTL
-#define SPI_UCSTAT    UCB3STAT
-#define SPI_UCRXBUF    UCB3RXBUF
-#define SPI_UCTXBUF    UCB3TXBUF
-#define SPI_UCIE    UCB3IE
-#define SPI_UCIFG    UCB3IFG
-#define SPI_UCIV    UCB3IV
-#else
-#error "Invalid SPI_USE_USCI in spi_config.h"
+#define SPI_USCI7_REGS          ((volatile uint8_t *)&UCB3CTL1)
+#define SPI_USCI7_VECTOR        USCI_B3_VECTOR
 #endif
-#else
+
+#define _SPI_USCI(n, x)    SPI_USCI##n##_##x
+#define SPI_USCI(n, x)     _SPI_USCI(n, x)
+
+#if (SPI_USE_USCI < 0) || (SPI_USE_USCI > 7)
 #error "Invalid SPI_USE_USCI in spi_config.h"
+#endif
+#if (SPI_BUS_COUNT > 1) && ((SPI_BUS1_USCI < 0) || (SPI_BUS1_USCI > 7) || (SPI_BUS1_USCI == SPI_USE_USCI))
+#error "Invalid SPI_BUS1_USCI in spi_config.h"
+#endif
+
+//==================================================================================================
+// DMA
+//==================================================================================================
+#if SPI_USE_DMA
+
+#if (SPI_DMA_TX_CH != SPI_DMA_NONE) && (SPI_DMA_RX_CH >= SPI_DMA_TX_CH)
+#error "SPI_DMA_RX_CH must have a higher priority (lower number) than SPI_DMA_TX_CH"
+#endif
+#if (SPI_BUS_COUNT > 1) && (SPI_BUS1_DMA_TX_CH != SPI_DMA_NONE) && (SPI_BUS1_DMA_RX_CH >= SPI_BUS1_DMA_TX_CH)
+#error "SPI_BUS1_DMA_RX_CH must have a higher priority (lower number) than SPI_BUS1_DMA_TX_CH"
+#endif
+
+// Channel registers are spaced 0x10 bytes apart starting at DMA0CTL
+#define SPI_DMA_CHREG(ch, ofs)    (*(volatile uint16_t *)((volatile uint8_t *)&DMA0CTL + ((ch) << 4) + (ofs)))
+#define SPI_DMA_CTL(ch)     SPI_DMA_CHREG(ch, 0x00)
+#define SPI_DMA_SA(ch)      SPI_DMA_CHREG(ch, 0x02)
+#define SPI_DMA_DA(ch)      SPI_DMA_CHREG(ch, 0x06)
+#define SPI_DMA_SZ(ch)      SPI_DMA_CHREG(ch, 0x0A)
+
+// Trigger select. Two channels per DMACTLx register; even channels use the low byte.
+#define SPI_DMA_TSEL(ch)    (*((volatile uint16_t *)&DMACTL0 + ((ch) >> 1)))
+#define SPI_DMA_TSEL_SHIFT(ch)    (((ch) & 1) << 3)
+
+// Highest channel number supported by DMAIV
+#define SPI_DMA_MAX_CH      8
+
 #endif
 
 #endif
@@ -0,0 +1,283 @@
+/*
+* Copyright (c) 2012, Alexander I. Mykyta
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+* ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/**
+* \addtogroup MOD_SPIQUEUE
+* \{
+**/
+
+/**
+* \file
+* \brief Code for \ref MOD_SPIQUEUE "SPI Transaction Queue"
+**/
+
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __MSP430__
+#include <msp430.h>
+#endif
+#include "spi.h"
+#include "spi_queue.h"
+
+//==================================================================================================
+// Internal Functions
+//==================================================================================================
+///\cond INTERNAL
+
+#ifdef __MSP430__
+#define ENTER_CRITICAL()    sr = __get_SR_register(); __disable_interrupt()
+#define EXIT_CRITICAL()     __bis_SR_register(sr & GIE)
+#else
+#define ENTER_CRITICAL()    (void)sr
+#define EXIT_CRITICAL()
+#endif
+
+static spiTransaction_t Pool[SPIQ_POOL_SIZE];
+static spiTransaction_t *FreeList;
+// One queue per bus
+static spiTransaction_t *volatile Head[SPI_BUS_COUNT];
+static spiTransaction_t *Tail[SPI_BUS_COUNT];
+static spiSelect_t Select;
+static spiQueueStats_t Stats;
+// startTransaction() is running on a bus, and the transaction at the head has to be started again
+static uint8_t Starting[SPI_BUS_COUNT];
+static volatile uint8_t Restart[SPI_BUS_COUNT];
+
+static void onHeaderDone(spiBus_t *bus);
+static void onDataDone(spiBus_t *bus);
+
+//--------------------------------------------------------------------------------------------------
+// Starts the transaction at the head of a bus queue. A transfer that completes before its start
+// call returns starts the next transaction from the loop here, so that a device polled for
+// thousands of times does not grow the stack.
+static void startTransaction(spiBus_t *bus)
+{
+    spiTransaction_t *t;
+    uint8_t b = bus->index;
+    uint16_t sr;
+
+    if (Starting[b])
+    {
+        Restart[b] = 1;
+        return;
+    }
+    Starting[b] = 1;
+    do
+    {
+        Restart[b] = 0;
+        t = Head[b];
+        Select(t->target, 1);
+        if (t->headerLen)
+        {
+            spiBusStartSendFrame(bus, t->header, t->headerLen, onHeaderDone);
+        }
+        else
+        {
+            onHeaderDone(bus);
+        }
+
+        ENTER_CRITICAL();
+        Starting[b] = Restart[b];
+        EXIT_CRITICAL();
+    } while (Starting[b]);
+}
+
+//--------------------------------------------------------------------------------------------------
+static void onHeaderDone(spiBus_t *bus)
+{
+    spiTransaction_t *t = Head[bus->index];
+
+    if (t->dir == SPIQ_DIR_POLL)
+    {
+        spiBusStartReadFrame(bus, &t->status, 1, onDataDone);
+    }
+    else if ((t->dir == SPIQ_DIR_NONE) || (t->dataLen == 0))
+    {
+        onDataDone(bus);
+    }
+    else if (t->dir == SPIQ_DIR_READ)
+    {
+        spiBusStartReadFrame(bus, t->pData, t->dataLen, onDataDone);
+    }
+    else
+    {
+        spiBusStartSendFrame(bus, t->pData, t->dataLen, onDataDone);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+static void onDataDone(spiBus_t *bus)
+{
+    spiTransaction_t *t = Head[bus->index];
+    spiTransaction_t *next;
+
+    Select(t->target, 0);
+
+    if ((t->dir == SPIQ_DIR_POLL) && (t->status & t->pollMask))
+    {
+        Stats.polls++;
+        startTransaction(bus);
+        return;
+    }
+
+    next = t->next;
+    Head[bus->index] = next;
+    if (next == 0)
+    {
+        Tail[bus->index] = 0;
+    }
+    Stats.depth--;
+    Stats.completed++;
+
+    if (t->callback)
+    {
+        t->callback(t);
+    }
+    t->next = FreeList;
+    FreeList = t;
+
+    if (next)
+    {
+        startTransaction(bus);
+    }
+}
+
+///\endcond
+//==================================================================================================
+// Functions
+//==================================================================================================
+
+void spiQueueInit(spiSelect_t select)
+{
+    uint8_t i;
+
+    Select = select;
+    for (i = 0; i < SPI_BUS_COUNT; i++)
+    {
+        Head[i] = 0;
+        Tail[i] = 0;
+        Starting[i] = 0;
+        Restart[i] = 0;
+    }
+    FreeList = 0;
+    for (i = 0; i < SPIQ_POOL_SIZE; i++)
+    {
+        Pool[i].next = FreeList;
+        FreeList = &Pool[i];
+    }
+    memset(&Stats, 0, sizeof(Stats));
+}
+
+//--------------------------------------------------------------------------------------------------
+spiTransaction_t* spiQueueAlloc(void)
+{
+    spiTransaction_t *t;
+    uint16_t sr;
+
+    ENTER_CRITICAL();
+    t = FreeList;
+    if (t)
+    {
+        FreeList = t->next;
+    }
+    EXIT_CRITICAL();
+
+    if (t)
+    {
+        memset(t, 0, sizeof(spiTransaction_t));
+    }
+    return(t);
+}
+
+//--------------------------------------------------------------------------------------------------
+void spiQueueFree(spiTransaction_t *t)
+{
+    uint16_t sr;
+
+    ENTER_CRITICAL();
+    t->next = FreeList;
+    FreeList = t;
+    EXIT_CRITICAL();
+}
+
+//--------------------------------------------------------------------------------------------------
+void spiQueueSubmit(spiTransaction_t *t)
+{
+    uint8_t start;
+    uint8_t b;
+    uint16_t sr;
+
+    if (t->bus == 0)
+    {
+        t->bus = SPI_BUS_DEFAULT;
+    }
+    b = t->bus->index;
+    t->next = 0;
+
+    ENTER_CRITICAL();
+    if (Tail[b])
+    {
+        Tail[b]->next = t;
+        start = 0;
+    }
+    else
+    {
+        Head[b] = t;
+        start = 1;
+    }
+    Tail[b] = t;
+    Stats.depth++;
+    if (Stats.depth > Stats.maxDepth)
+    {
+        Stats.maxDepth = Stats.depth;
+    }
+    EXIT_CRITICAL();
+
+    if (start)
+    {
+        startTransaction(t->bus);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+uint8_t spiQueueBusy(spiBus_t *bus)
+{
+    return((Head[bus->index]) ? 1 : 0);
+}
+
+//--------------------------------------------------------------------------------------------------
+void spiQueueWait(spiBus_t *bus)
+{
+    while (Head[bus->index]);
+}
+
+//--------------------------------------------------------------------------------------------------
+const spiQueueStats_t* spiQueueGetStats(void)
+{
+    return(&Stats);
+}
+
+///\}
@@ -0,0 +1,168 @@
+/*
+* Copyright (c) 2012, Alexander I. Mykyta
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+* ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/**
+* \addtogroup MOD_SPIQUEUE SPI Transaction Queue
+* \brief Queues chip-select framed SPI transactions and services them in the background
+*
+* Each transaction asserts a chip-enable target, sends a short command/address header, then
+* reads or writes a data buffer before releasing the chip-enable. Transactions are serviced one
+* after another from the SPI completion interrupt (DMA or USCI) so that the application can do
+* other work or enter a low power mode in the meantime. Each bus has its own queue. A poll
+* transaction (#SPIQ_DIR_POLL) holds back the transactions behind it until a device reports
+* ready. \n
+* Descriptors come from a fixed-size pool. No heap is used.
+*
+* This module requires the following module:
+*    - \ref MOD_SPI "SPI Bus"
+*
+* \{
+**/
+
+/**
+* \file
+* \brief Include file for \ref MOD_SPIQUEUE "SPI Transaction Queue"
+**/
+
+#ifndef _SPI_QUEUE_H_
+#define _SPI_QUEUE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include "spi.h"
+#include "spi_queue_config.h"
+
+//==================================================================================================
+// Defines
+//==================================================================================================
+
+/// \name Transfer Directions
+///\{
+#define SPIQ_DIR_NONE    0    ///< Header only
+#define SPIQ_DIR_READ    1    ///< Read \c dataLen bytes into \c pData after the header
+#define SPIQ_DIR_WRITE   2    ///< Write \c dataLen bytes from \c pData after the header
+#define SPIQ_DIR_POLL    3    ///< Read one byte into \c status after the header. The transaction
+                              ///< is repeated until none of the bits in \c pollMask are set.
+///\}
+
+//==================================================================================================
+// Types
+//==================================================================================================
+
+    typedef struct spiTransaction_s spiTransaction_t;
+
+    /**
+    * \brief Transaction completion callback
+    * \attention Called from within an interrupt service routine. The descriptor is returned to
+    *            the pool once the callback returns.
+    **/
+    typedef void (*spiTransactionCallback_t)(spiTransaction_t *t);
+
+    /**
+    * \brief Chip-enable hook
+    * \param [in] target Value of spiTransaction_t::target
+    * \param [in] enable 1 = assert chip-enable, 0 = release
+    **/
+    typedef void (*spiSelect_t)(uint8_t target, uint8_t enable);
+
+    ///\brief Transaction descriptor
+    struct spiTransaction_s
+    {
+        spiBus_t *bus;                      ///< Bus to use. \c NULL selects #SPI_BUS_DEFAULT
+        uint8_t target;                     ///< Chip-enable target passed to the select hook
+        uint8_t headerLen;                  ///< Number of bytes in \c header
+        uint8_t header[SPIQ_HEADER_MAX];    ///< Command and address bytes
+        uint8_t dir;                        ///< One of the \c SPIQ_DIR_x directions
+        uint8_t *pData;                     ///< Data buffer
+        uint16_t dataLen;                   ///< Number of bytes in the data phase
+        uint8_t pollMask;                   ///< #SPIQ_DIR_POLL: bits that repeat the transaction
+        uint8_t status;                     ///< #SPIQ_DIR_POLL: last byte read
+        spiTransactionCallback_t callback;  ///< Completion callback. Can be \c NULL
+        void *context;                      ///< User context
+        spiTransaction_t *next;             ///< \private
+    };
+
+    ///\brief Queue statistics
+    typedef struct
+    {
+        uint8_t depth;          ///< Transactions currently queued, including the active one
+        uint8_t maxDepth;       ///< Highest depth seen since spiQueueInit()
+        uint16_t completed;     ///< Number of completed transactions (wraps)
+        uint16_t polls;         ///< Number of repeated #SPIQ_DIR_POLL transactions (wraps)
+    } spiQueueStats_t;
+
+//==================================================================================================
+// Function Prototypes
+//==================================================================================================
+
+    /**
+    * \brief Initializes the transaction queue
+    * \param [in] select Chip-enable hook
+    * \attention The SPI buses must already be initialized
+    **/
+    void spiQueueInit(spiSelect_t select);
+
+    /**
+    * \brief Get a descriptor from the pool
+    * \return Pointer to an zeroed descriptor or \c NULL if the pool is exhausted
+    **/
+    spiTransaction_t* spiQueueAlloc(void);
+
+    /**
+    * \brief Return an unsubmitted descriptor to the pool
+    **/
+    void spiQueueFree(spiTransaction_t *t);
+
+    /**
+    * \brief Append a descriptor to the queue. Starts it immediately if the bus is idle.
+    **/
+    void spiQueueSubmit(spiTransaction_t *t);
+
+    /**
+    * \brief Check whether any transactions are pending on a bus
+    * \retval 0 Idle
+    * \retval 1 Busy
+    **/
+    uint8_t spiQueueBusy(spiBus_t *bus);
+
+    /**
+    * \brief Block until all transactions queued on a bus have completed
+    **/
+    void spiQueueWait(spiBus_t *bus);
+
+    /**
+    * \brief Get a pointer to the queue statistics
+    **/
+    const spiQueueStats_t* spiQueueGetStats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+///\}
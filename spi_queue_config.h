@@ -0,0 +1,30 @@
+/**
+* \addtogroup MOD_SPIQUEUE
+* \{
+**/
+
+/**
+* \file
+* \brief Configuration include file for \ref MOD_SPIQUEUE "SPI Transaction Queue"
+**/
+
+#ifndef _SPI_QUEUE_CONFIG_H_
+#define _SPI_QUEUE_CONFIG_H_
+
+//==================================================================================================
+/// \name Configuration
+/// Configuration defines for the \ref MOD_SPIQUEUE module
+/// \{
+//==================================================================================================
+
+/// Number of transaction descriptors in the pool
+#define SPIQ_POOL_SIZE      8 ///< \hideinitializer
+
+/// Maximum number of command/address header bytes per transaction
+#define SPIQ_HEADER_MAX     5 ///< \hideinitializer
+
+///\}
+
+#endif
+
+///\}
@@ -0,0 +1,183 @@
+/*
+* Copyright (c) 2012, Alexander I. Mykyta
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+* ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/**
+* \addtogroup MOD_SPI
+* \{
+**/
+
+/**
+* \file
+* \brief Host implementation of \ref MOD_SPI "SPI Bus" on top of the
+*        \ref MOD_SST25VF_SIM "SST25VF Serial Flash Simulator"
+**/
+
+#ifndef __MSP430__ // MSP430 builds use spi.c instead
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "SST25VF_sim.h"
+#include "spi.h"
+
+///\cond INTERNAL
+
+#define SIM_BUS_INIT(idx, rxch, txch) \
+    {NULL, NULL, 0, NULL, 0, (idx), 0, (rxch), (txch), 0, 0, {0, 0, 0}, NULL, 0, NULL, NULL, 0, 0}
+
+#define busClock(bus)    spiProfileClock(&(bus)->profile)
+
+///\endcond
+
+spiBus_t spiBus[SPI_BUS_COUNT] =
+{
+    SIM_BUS_INIT(0, SPI_DMA_RX_CH, SPI_DMA_TX_CH),
+#if SPI_BUS_COUNT > 1
+    SIM_BUS_INIT(1, SPI_BUS1_DMA_RX_CH, SPI_BUS1_DMA_TX_CH),
+#endif
+};
+
+//==================================================================================================
+// Functions
+//==================================================================================================
+
+void spiBusInit(spiBus_t *bus, uint8_t spi_mode)
+{
+    bus->profile.clkSrc = SPI_CLK_SRC;
+    bus->profile.mode = spi_mode;
+    bus->profile.clkDiv = SPI_CLK_DIV;
+    bus->callback = NULL;
+    bus->busy = 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+void spiBusUninit(spiBus_t *bus)
+{
+    bus->busy = 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+void spiBusSetProfile(spiBus_t *bus, const spiProfile_t *profile)
+{
+    bus->profile = *profile;
+}
+
+//--------------------------------------------------------------------------------------------------
+void spiMakeProfile(spiProfile_t *profile, uint32_t maxHz, uint8_t spi_mode)
+{
+    uint32_t div;
+
+    div = (SPI_SMCLK_FREQ + maxHz - 1) / maxHz;
+    if (div < SPI_CLK_DIV_MIN)
+    {
+        div = SPI_CLK_DIV_MIN;
+    }
+    if (div > 0xFFFF)
+    {
+        div = 0xFFFF;
+    }
+
+    profile->clkSrc = 2;
+    profile->mode = spi_mode;
+    profile->clkDiv = div;
+}
+
+//--------------------------------------------------------------------------------------------------
+uint32_t spiProfileClock(const spiProfile_t *profile)
+{
+    uint32_t src = (profile->clkSrc == 1) ? SPI_ACLK_FREQ : SPI_SMCLK_FREQ;
+    return(src / profile->clkDiv);
+}
+
+//--------------------------------------------------------------------------------------------------
+uint8_t spiBusSOMILevel(spiBus_t *bus)
+{
+    sstSim_Advance(SIM_PIN_SAMPLE_NS);
+    return(sstSim_SOLevel(bus->index));
+}
+
+//--------------------------------------------------------------------------------------------------
+uint8_t spiBusSendByte(spiBus_t *bus, uint8_t data)
+{
+    return(sstSim_Transfer(bus->index, data, busClock(bus)));
+}
+
+//--------------------------------------------------------------------------------------------------
+void spiBusReadFrame(spiBus_t *bus, uint8_t* pBuffer, uint16_t size)
+{
+    uint32_t clk = busClock(bus);
+    while (size--)
+    {
+        *pBuffer++ = sstSim_Transfer(bus->index, DUMMY_CHAR, clk);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+void spiBusSendFrame(spiBus_t *bus, const uint8_t* pBuffer, uint16_t size)
+{
+    uint32_t clk = busClock(bus);
+    while (size--)
+    {
+        sstSim_Transfer(bus->index, *pBuffer++, clk);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+void spiBusStartReadFrame(spiBus_t *bus, uint8_t* pBuffer, uint16_t size, spiCallback_t callback)
+{
+    // Background transfers complete before returning
+    spiBusReadFrame(bus, pBuffer, size);
+    if (callback)
+    {
+        callback(bus);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+void spiBusStartSendFrame(spiBus_t *bus, const uint8_t* pBuffer, uint16_t size, spiCallback_t callback)
+{
+    spiBusSendFrame(bus, pBuffer, size);
+    if (callback)
+    {
+        callback(bus);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+uint8_t spiBusFrameBusy(spiBus_t *bus)
+{
+    (void)bus;
+    return(0);
+}
+
+//--------------------------------------------------------------------------------------------------
+void spiBusWaitFrame(spiBus_t *bus)
+{
+    (void)bus;
+}
+
+#endif // __MSP430__
+
+///\}